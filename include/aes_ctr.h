@@ -0,0 +1,65 @@
+//
+// Created by matthew on 3/16/25.
+//
+
+#ifndef ICRYPT_AES_CTR_H
+#define ICRYPT_AES_CTR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * The number of bytes in an AES-256 key
+ */
+constexpr size_t aesKeySize = 32;
+
+
+/**
+ * The number of bytes in an AES block, which is also the size of the initial counter block
+ */
+constexpr size_t aesBlockSize = 16;
+
+
+/**
+ * An AES-256 cipher in counter mode, as specified in FIPS 197 and NIST SP 800-38A.  The keystream block at each index is
+ * the encryption of the initial counter block plus the index, so any range of the keystream can be generated
+ * independently and from any number of threads.  Uses AES-NI when the CPU supports it, and otherwise a bitsliced
+ * software cipher that never indexes memory by secret data
+ */
+class AesCtr {
+
+    std::array<uint8_t, aesBlockSize * 15> roundKeys;
+    uint64_t counterHigh;
+    uint64_t counterLow;
+    bool hardware;
+
+public:
+
+    /**
+     * Expands a key for encrypting with
+     * @param key The 256-bit key
+     * @param counter The initial counter block, which must never be reused with the same key
+     * @param allowHardware Whether to use AES-NI if the CPU supports it.  The output is identical either way
+     */
+    AesCtr(const std::array<uint8_t, aesKeySize>& key, const std::array<uint8_t, aesBlockSize>& counter,
+           bool allowHardware = true);
+
+    /**
+     * XORs data with the keystream, which both encrypts and decrypts it
+     * @param data The data to XOR in place
+     * @param length The number of bytes to XOR
+     * @param position The position of the first byte within the keystream
+     */
+    void apply(char* data, size_t length, size_t position = 0) const;
+
+    /**
+     * Encrypts a single block with the expanded key, without counter mode
+     * @param in The block to encrypt
+     * @param out The buffer to write the encrypted block to
+     */
+    void encryptBlock(const uint8_t* in, uint8_t* out) const;
+};
+
+#endif //ICRYPT_AES_CTR_H
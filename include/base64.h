@@ -5,20 +5,62 @@
 #ifndef ICRYPT_BASE64_H
 #define ICRYPT_BASE64_H
 
+#include <string>
+#include <string_view>
+
+
+/**
+ * Gets the number of characters that encoding bytes into base64 produces, including padding
+ * @param length The number of bytes to encode
+ * @return The length of the base64 encoded text
+ */
+size_t base64EncodedSize(size_t length);
+
+
+/**
+ * Gets the largest number of bytes that decoding base64 text can produce.  Fewer bytes are produced if the text ends
+ * early with padding or a character outside of the alphabet
+ * @param length The number of base64 characters to decode
+ * @return The largest length of the decoded bytes
+ */
+size_t base64DecodedSize(size_t length);
+
+
+/**
+ * Encodes bytes into base64 in a buffer provided by the caller
+ * @param in The bytes to encode
+ * @param out The buffer to write the encoded text to, at least base64EncodedSize(in.length()) characters long
+ * @param threads The number of threads to encode large inputs with, or 0 to use all available threads
+ * @return The number of characters written
+ */
+size_t base64Encode(std::string_view in, char* out, int threads = 1);
+
+
+/**
+ * Decodes base64 text in a buffer provided by the caller
+ * @param in The base64 encoded text
+ * @param out The buffer to write the decoded bytes to, at least base64DecodedSize(in.length()) bytes long
+ * @param threads The number of threads to decode large inputs with, or 0 to use all available threads
+ * @return The number of bytes written
+ */
+size_t base64Decode(std::string_view in, char* out, int threads = 1);
+
 
 /**
  * Encodes a string into base64
  * @param in The string to encode
+ * @param threads The number of threads to encode large strings with, or 0 to use all available threads
  * @return The base64 encoded string
  */
-std::string base64Encode(const std::string& in);
+std::string base64Encode(std::string_view in, int threads = 1);
 
 
 /**
  * Decodes a base64 encoded string
  * @param in The base64 encoded string
+ * @param threads The number of threads to decode large strings with, or 0 to use all available threads
  * @return The decoded string
  */
-std::string base64Decode(const std::string& in);
+std::string base64Decode(std::string_view in, int threads = 1);
 
 #endif //ICRYPT_BASE64_H
@@ -0,0 +1,52 @@
+//
+// Created by matthew on 3/2/25.
+//
+
+#ifndef ICRYPT_COMPRESSION_H
+#define ICRYPT_COMPRESSION_H
+
+#include <cstddef>
+#include <string>
+
+
+/**
+ * The fastest compression level, which still shrinks most text several times over
+ */
+constexpr int fastestCompression = 1;
+
+
+/**
+ * The smallest compression level, which is the slowest to compress but no slower to decompress
+ */
+constexpr int smallestCompression = 9;
+
+
+/**
+ * The most times larger than an image's text capacity that a compressed payload may decompress to.  Deflate can expand
+ * about a thousand times over, so this bounds the memory that a crafted image can make decoding allocate
+ */
+constexpr size_t maxDecompressionRatio = 64;
+
+
+/**
+ * Compresses a payload with deflate so that it touches fewer pixels when embedded.  Large payloads are split into
+ * segments that are compressed in parallel and joined into a single zlib stream, which is the same for any number of
+ * threads
+ * @param payload The payload to compress, which may hold any bytes
+ * @param level The compression level, from fastestCompression to smallestCompression
+ * @param threads The number of threads to compress with, or 0 to use all available threads
+ * @return The compressed payload in the zlib format
+ */
+std::string compressPayload(const std::string& payload, int level, int threads = 1);
+
+
+/**
+ * Decompresses a payload that was compressed with compressPayload
+ * @param compressed The compressed payload
+ * @param payload The string to write the decompressed payload into
+ * @param maxLength The longest payload to decompress.  Decompression stops as soon as the payload grows past it
+ * @return True if the payload was decompressed, false if it was corrupt, truncated, or longer than maxLength
+ */
+bool decompressPayload(const std::string& compressed, std::string& payload, size_t maxLength);
+
+#endif //ICRYPT_COMPRESSION_H
@@ -0,0 +1,133 @@
+//
+// Created by matthew on 2/3/25.
+//
+
+#ifndef ICRYPT_EMBED_KERNELS_H
+#define ICRYPT_EMBED_KERNELS_H
+
+#include <cstddef>
+#include <vector>
+#include <opencv2/core/hal/interface.h>
+
+
+/**
+ * Embeds characters into a run of grounded channels
+ * @param channels The channels to embed the characters into
+ * @param chars The characters to embed
+ * @param count The number of characters to embed
+ */
+typedef void (*EmbedKernel)(uchar* channels, const char* chars, size_t count);
+
+
+/**
+ * Extracts characters from a run of channels
+ * @param channels The channels to extract the characters from
+ * @param chars The buffer to write the characters to
+ * @param count The number of characters to extract
+ */
+typedef void (*ExtractKernel)(const uchar* channels, char* chars, size_t count);
+
+
+/**
+ * A set of kernels for one instruction set that ground, embed, and extract characters within a run of pixel channels.
+ * The embedding kernels assume the channels have already been grounded and always work on whole characters
+ */
+struct EmbedKernels {
+
+    /**
+     * The name of the instruction set that the kernels use
+     */
+    const char* name;
+
+    /**
+     * Clears the low bits of each channel
+     * @param channels The channels to ground
+     * @param length The number of channels to ground
+     * @param mask The mask to apply to each channel
+     */
+    void (*ground)(uchar* channels, size_t length, uchar mask);
+
+    /**
+     * Embeds characters using 1 bit per channel (8 channels per character)
+     */
+    EmbedKernel embed1;
+
+    /**
+     * Embeds characters using 2 bits per channel (4 channels per character)
+     */
+    EmbedKernel embed2;
+
+    /**
+     * Embeds characters using 4 bits per channel (2 channels per character)
+     */
+    EmbedKernel embed4;
+
+    /**
+     * Extracts characters using 1 bit per channel (8 channels per character)
+     */
+    ExtractKernel extract1;
+
+    /**
+     * Extracts characters using 2 bits per channel (4 channels per character)
+     */
+    ExtractKernel extract2;
+
+    /**
+     * Extracts characters using 4 bits per channel (2 channels per character)
+     */
+    ExtractKernel extract4;
+};
+
+
+/**
+ * Clears the low bits of each channel of any type
+ * @tparam Channel The type of each channel
+ * @param channels The channels to ground
+ * @param length The number of channels to ground
+ * @param mask The mask to apply to each channel
+ */
+template<typename Channel>
+void groundGeneric(Channel* channels, size_t length, Channel mask);
+
+
+/**
+ * Embeds characters into a run of grounded channels of any type and with any bit width.  Bit widths of 1, 2, and 4
+ * use the same layouts as the EmbedKernels.  Other bit widths do not evenly divide a character, so each group of
+ * characters is packed into a bit stream, starting at the lowest bit of the first character, and split across
+ * consecutive channels starting at the lowest bits.  The inner loops are unrolled for each bit width
+ * @tparam BitWidth The number of bits used for encoding within each channel (1, 2, 3, 4, 6, or 8)
+ * @tparam Channel The type of each channel
+ * @param channels The channels to embed the characters into
+ * @param chars The characters to embed
+ * @param count The number of characters to embed, a multiple of the number of characters in each group
+ */
+template<int BitWidth, typename Channel>
+void embedGeneric(Channel* channels, const char* chars, size_t count);
+
+
+/**
+ * Extracts characters that were embedded with embedGeneric
+ * @tparam BitWidth The number of bits used for encoding within each channel (1, 2, 3, 4, 6, or 8)
+ * @tparam Channel The type of each channel
+ * @param channels The channels to extract the characters from
+ * @param chars The buffer to write the characters to
+ * @param count The number of characters to extract, a multiple of the number of characters in each group
+ */
+template<int BitWidth, typename Channel>
+void extractGeneric(const Channel* channels, char* chars, size_t count);
+
+
+/**
+ * Gets the fastest set of kernels supported by the current CPU.  The CPU is only checked on the first call
+ * @return The selected kernels
+ */
+const EmbedKernels& embedKernels();
+
+
+/**
+ * Gets every set of kernels supported by the current CPU, starting with the portable scalar kernels
+ * @return The supported kernels
+ */
+std::vector<const EmbedKernels*> availableEmbedKernels();
+
+#endif //ICRYPT_EMBED_KERNELS_H
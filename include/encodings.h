@@ -5,11 +5,25 @@
 #ifndef ICRYPT_ENCODINGS_H
 #define ICRYPT_ENCODINGS_H
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 
 
 /**
- * An abstract encoding specification
+ * The key material that an encoding derives from a key.  A schedule never changes once it is prepared, so it can be
+ * reused for any number of texts and shared between threads
+ */
+struct KeySchedule {
+
+    virtual ~KeySchedule() = default;
+};
+
+
+/**
+ * An abstract encoding specification.  Encodings hold no state, so a single instance of each is shared by every caller.
+ * Every encoding transforms text in place without changing its length, and the string versions are wrappers over that
  */
 struct Encoding {
 
@@ -19,23 +33,166 @@ struct Encoding {
      * The name identifier of the encoding
      * @return The encoding name
      */
-    virtual std::string name() = 0;
+    virtual std::string name() const = 0;
+
+    /**
+     * The numeric identifier of the encoding that is stored in payload headers
+     * @return The encoding identifier
+     */
+    virtual uint8_t id() const = 0;
+
+    /**
+     * The number of random bytes that must be stored with every encoded text to prepare the key for it, or 0 if the
+     * encoding is deterministic
+     * @return The nonce size in bytes
+     */
+    virtual size_t nonceSize() const { return 0; }
+
+    /**
+     * Whether every encoded text must be embedded after a payload header, because its length cannot be found by
+     * searching for the end of the text.  Encodings with a nonce store it after the header, and encodings whose text may
+     * hold null characters would end a search early
+     * @return True if the encoding always needs a header
+     */
+    virtual bool requiresHeader() const { return nonceSize() > 0; }
 
     /**
-     * Decodes a std::string using the given key and returns the result
+     * Derives the key material that the encoding needs from a key, so that it is only derived once for every text
+     * @param key The key to prepare
+     * @param nonce The nonce of the text, which is ignored by deterministic encodings and padded with zeros to nonceSize
+     * @return The prepared key schedule
+     */
+    virtual std::shared_ptr<const KeySchedule> prepare(const std::string& key, const std::string& nonce = "") const = 0;
+
+    /**
+     * Decodes text in place using the given key schedule
+     * @param text The encoded text, which is overwritten with the decoded text
+     * @param length The number of characters to decode
+     * @param schedule The key schedule to decode with, which must have been prepared by this encoding
+     * @param threads The number of threads to decode with, or 0 to use all available threads
+     */
+    virtual void decode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const = 0;
+
+    /**
+     * Encodes text in place using the given key schedule
+     * @param text The original text, which is overwritten with the encoded text
+     * @param length The number of characters to encode
+     * @param schedule The key schedule to encode with, which must have been prepared by this encoding
+     * @param threads The number of threads to encode with, or 0 to use all available threads
+     */
+    virtual void encode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const = 0;
+
+    /**
+     * Decodes arbitrary bytes in place using the given key schedule.  Unlike decode, every shift wraps around all 256
+     * byte values
+     * @param bytes The encoded bytes, which are overwritten with the decoded bytes
+     * @param length The number of bytes to decode
+     * @param schedule The key schedule to decode with, which must have been prepared by this encoding
+     * @param threads The number of threads to decode with, or 0 to use all available threads
+     */
+    virtual void decodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const = 0;
+
+    /**
+     * Encodes arbitrary bytes in place using the given key schedule.  Unlike encode, every shift wraps around all 256
+     * byte values
+     * @param bytes The original bytes, which are overwritten with the encoded bytes
+     * @param length The number of bytes to encode
+     * @param schedule The key schedule to encode with, which must have been prepared by this encoding
+     * @param threads The number of threads to encode with, or 0 to use all available threads
+     */
+    virtual void encodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const = 0;
+
+    /**
+     * Encodes a piece of a longer text in place, exactly as encode would encode it at its position within that text.
+     * The piece is encoded on the calling thread, so separate pieces can be encoded from separate threads
+     * @param text The piece of the original text, which is overwritten with the encoded piece
+     * @param length The number of characters in the piece
+     * @param position The index of the first character of the piece within the whole text
+     * @param schedule The key schedule to encode with, which must have been prepared by this encoding
+     */
+    virtual void encodeAt(char* text, size_t length, size_t position, const KeySchedule& schedule) const = 0;
+
+    /**
+     * Encodes a piece of a longer run of bytes in place, exactly as encodeBytes would encode it at its position within
+     * that run.  The piece is encoded on the calling thread, so separate pieces can be encoded from separate threads
+     * @param bytes The piece of the original bytes, which is overwritten with the encoded piece
+     * @param length The number of bytes in the piece
+     * @param position The index of the first byte of the piece within the whole run
+     * @param schedule The key schedule to encode with, which must have been prepared by this encoding
+     */
+    virtual void encodeBytesAt(char* bytes, size_t length, size_t position, const KeySchedule& schedule) const = 0;
+
+    /**
+     * Decodes a std::string using the given key schedule and returns the result
+     * @param encoded The original, encoded std::string
+     * @param schedule The key schedule to decode with, which must have been prepared by this encoding
+     * @param threads The number of threads to decode with, or 0 to use all available threads
+     * @return The decoded std::string
+     */
+    std::string decode(std::string encoded, const KeySchedule& schedule, int threads = 1) const;
+
+    /**
+     * Encodes a std::string using the given key schedule and returns the result
+     * @param raw The original std::string
+     * @param schedule The key schedule to encode with, which must have been prepared by this encoding
+     * @param threads The number of threads to encode with, or 0 to use all available threads
+     * @return The encoded std::string
+     */
+    std::string encode(std::string raw, const KeySchedule& schedule, int threads = 1) const;
+
+    /**
+     * Decodes arbitrary bytes using the given key schedule and returns the result
+     * @param encoded The original, encoded bytes
+     * @param schedule The key schedule to decode with, which must have been prepared by this encoding
+     * @param threads The number of threads to decode with, or 0 to use all available threads
+     * @return The decoded bytes
+     */
+    std::string decodeBytes(std::string encoded, const KeySchedule& schedule, int threads = 1) const;
+
+    /**
+     * Encodes arbitrary bytes using the given key schedule and returns the result
+     * @param raw The original bytes
+     * @param schedule The key schedule to encode with, which must have been prepared by this encoding
+     * @param threads The number of threads to encode with, or 0 to use all available threads
+     * @return The encoded bytes
+     */
+    std::string encodeBytes(std::string raw, const KeySchedule& schedule, int threads = 1) const;
+
+    /**
+     * Decodes a std::string using the given key, preparing the key for this call only
      * @param encoded The original, encoded std::string
      * @param key The key to decode with
+     * @param threads The number of threads to decode with, or 0 to use all available threads
      * @return The decoded std::string
      */
-    virtual std::string decode(std::string encoded, const std::string& key) = 0;
+    std::string decode(std::string encoded, const std::string& key, int threads = 1) const;
 
     /**
-     * Encodes a std::string using the given key and returns the result
+     * Encodes a std::string using the given key, preparing the key for this call only
      * @param raw The original std::string
      * @param key The key to encode with
+     * @param threads The number of threads to encode with, or 0 to use all available threads
      * @return The encoded std::string
      */
-    virtual std::string encode(std::string raw, const std::string& key) = 0;
+    std::string encode(std::string raw, const std::string& key, int threads = 1) const;
+
+    /**
+     * Decodes arbitrary bytes using the given key, preparing the key for this call only
+     * @param encoded The original, encoded bytes
+     * @param key The key to decode with
+     * @param threads The number of threads to decode with, or 0 to use all available threads
+     * @return The decoded bytes
+     */
+    std::string decodeBytes(std::string encoded, const std::string& key, int threads = 1) const;
+
+    /**
+     * Encodes arbitrary bytes using the given key, preparing the key for this call only
+     * @param raw The original bytes
+     * @param key The key to encode with
+     * @param threads The number of threads to encode with, or 0 to use all available threads
+     * @return The encoded bytes
+     */
+    std::string encodeBytes(std::string raw, const std::string& key, int threads = 1) const;
 };
 
 
@@ -44,11 +201,28 @@ struct Encoding {
  */
 struct PlainEncoding final : Encoding {
 
-    std::string name() override;
+    using Encoding::decode;
+    using Encoding::encode;
+    using Encoding::decodeBytes;
+    using Encoding::encodeBytes;
+
+    std::string name() const override;
+
+    uint8_t id() const override;
+
+    std::shared_ptr<const KeySchedule> prepare(const std::string& key, const std::string& nonce = "") const override;
+
+    void decode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
 
-    std::string decode(std::string encoded, const std::string& key) override;
+    void encode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
 
-    std::string encode(std::string raw, const std::string& key) override;
+    void decodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeAt(char* text, size_t length, size_t position, const KeySchedule& schedule) const override;
+
+    void encodeBytesAt(char* bytes, size_t length, size_t position, const KeySchedule& schedule) const override;
 };
 
 
@@ -57,11 +231,28 @@ struct PlainEncoding final : Encoding {
  */
 struct ShiftAllEncoding final : Encoding {
 
-    std::string name() override;
+    using Encoding::decode;
+    using Encoding::encode;
+    using Encoding::decodeBytes;
+    using Encoding::encodeBytes;
+
+    std::string name() const override;
+
+    uint8_t id() const override;
+
+    std::shared_ptr<const KeySchedule> prepare(const std::string& key, const std::string& nonce = "") const override;
+
+    void decode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
 
-    std::string decode(std::string encoded, const std::string& key) override;
+    void encode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
 
-    std::string encode(std::string raw, const std::string& key) override;
+    void decodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeAt(char* text, size_t length, size_t position, const KeySchedule& schedule) const override;
+
+    void encodeBytesAt(char* bytes, size_t length, size_t position, const KeySchedule& schedule) const override;
 };
 
 
@@ -70,19 +261,105 @@ struct ShiftAllEncoding final : Encoding {
  */
 struct ShiftCharEncoding final : Encoding {
 
-    std::string name() override;
+    using Encoding::decode;
+    using Encoding::encode;
+    using Encoding::decodeBytes;
+    using Encoding::encodeBytes;
+
+    std::string name() const override;
+
+    uint8_t id() const override;
+
+    std::shared_ptr<const KeySchedule> prepare(const std::string& key, const std::string& nonce = "") const override;
+
+    void decode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void decodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeAt(char* text, size_t length, size_t position, const KeySchedule& schedule) const override;
+
+    void encodeBytesAt(char* bytes, size_t length, size_t position, const KeySchedule& schedule) const override;
+};
+
+
+/**
+ * An AES-256 encoding in counter mode.  The key is the SHA-256 digest of the key text, and the initial counter block is a
+ * random nonce that is stored with the text, so the same text never encodes the same way twice.  Encoding XORs every byte
+ * with the keystream, so text and bytes encode identically and decoding is the same operation as encoding
+ */
+struct AesCtrEncoding final : Encoding {
+
+    using Encoding::decode;
+    using Encoding::encode;
+    using Encoding::decodeBytes;
+    using Encoding::encodeBytes;
+
+    std::string name() const override;
+
+    uint8_t id() const override;
+
+    size_t nonceSize() const override;
+
+    std::shared_ptr<const KeySchedule> prepare(const std::string& key, const std::string& nonce = "") const override;
+
+    void decode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void decodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeAt(char* text, size_t length, size_t position, const KeySchedule& schedule) const override;
+
+    void encodeBytesAt(char* bytes, size_t length, size_t position, const KeySchedule& schedule) const override;
+};
+
+
+/**
+ * A hashchar encoding.  Like shiftchar, every character is shifted up by its own amount, but the shifts come from a fixed
+ * integer hash of the SHA-256 digest of the key and the character index instead of std::hash, so encoded text decodes
+ * the same with any compiler or platform.  Each hash generates the shifts of 32 characters at once
+ */
+struct HashCharEncoding final : Encoding {
+
+    using Encoding::decode;
+    using Encoding::encode;
+    using Encoding::decodeBytes;
+    using Encoding::encodeBytes;
+
+    std::string name() const override;
+
+    uint8_t id() const override;
+
+    bool requiresHeader() const override;
+
+    std::shared_ptr<const KeySchedule> prepare(const std::string& key, const std::string& nonce = "") const override;
+
+    void decode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encode(char* text, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void decodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
+
+    void encodeBytes(char* bytes, size_t length, const KeySchedule& schedule, int threads = 1) const override;
 
-    std::string decode(std::string encoded, const std::string& key) override;
+    void encodeAt(char* text, size_t length, size_t position, const KeySchedule& schedule) const override;
 
-    std::string encode(std::string raw, const std::string& key) override;
+    void encodeBytesAt(char* bytes, size_t length, size_t position, const KeySchedule& schedule) const override;
 };
 
 
 /**
- * Gets a pointer to an encoding object based off of the name of the encoding
+ * Gets an encoding based off of the name of the encoding.  Every encoding is a single shared instance, so the pointer
+ * stays valid for the whole program and must not be deleted
  * @param name The name of the encoding to get
- * @return A pointer to an encoding instance
+ * @return A pointer to the encoding instance
  */
-Encoding* encodingFromName(const std::string& name);
+const Encoding* encodingFromName(const std::string& name);
 
 #endif //ICRYPT_ENCODINGS_H
@@ -5,24 +5,110 @@
 #ifndef ICRYPT_IMAGE_ENCODE_H
 #define ICRYPT_IMAGE_ENCODE_H
 
+#include <limits>
+#include <random>
+#include <vector>
 #include <opencv2/opencv.hpp>
 
 
 /**
- * Encodes text into an image by using the modulo of the pixel values to encode the bytes of the text
+ * Gets the bit widths that text can be encoded with.  Larger bit widths touch fewer pixels but add more noise
+ * @return The supported bit widths
+ */
+std::vector<int> supportedBitWidths();
+
+
+/**
+ * Checks whether text can be encoded with the given bit width
+ * @param bitWidth The number of bits used for encoding within each channel
+ * @return True if the bit width is supported
+ */
+bool isSupportedBitWidth(int bitWidth);
+
+
+/**
+ * Produces the characters of a message on demand, so that they can be generated right before they are embedded instead
+ * of being built in full first.  Characters may be requested in any order and from several threads at once
+ */
+struct MessageSource {
+
+    virtual ~MessageSource() = default;
+
+    /**
+     * The number of characters in the message
+     * @return The message length
+     */
+    virtual size_t length() const = 0;
+
+    /**
+     * Gets a run of consecutive characters of the message
+     * @param index The index of the first character to get
+     * @param count The number of characters to get, which all lie within the message
+     * @param buffer A buffer of at least count characters to produce the characters in, if needed
+     * @return A pointer to the characters, which is either the buffer or storage owned by the source
+     */
+    virtual const char* chars(size_t index, size_t count, char* buffer) const = 0;
+};
+
+
+/**
+ * Encodes text into an image by using the modulo of the pixel values to encode the bytes of the text.  The text runs
+ * through every channel of every pixel in order, so images with 1 to 4 channels are all encoded in place
  * @param image The image to encode the text into
  * @param text The text to encode
- * @param bitWidth The number of bits to use for encoding within each channel (1, 2, or 4)
+ * @param bitWidth The number of bits to use for encoding within each channel (see supportedBitWidths)
+ * @param threads The number of threads to embed with, or 0 to use all available threads
+ * @param noiseSeed The seed of the noise that fills the image after the end of the text
+ * @param noiseLength The number of characters of noise to add after the end of the text.  Pixels past the noise are
+ * left untouched, so short messages only cost as much as the pixels they need.  By default the noise fills the image
  */
-void encodeText(cv::Mat& image, const std::string& text, int bitWidth);
+void encodeText(cv::Mat& image, const std::string& text, int bitWidth, int threads = 1,
+                uint64_t noiseSeed = std::random_device{}(), size_t noiseLength = std::numeric_limits<size_t>::max());
+
+
+/**
+ * Encodes a message into an image exactly as encodeText would encode its characters, producing each block of
+ * characters from the source right before it is embedded
+ * @param image The image to encode the message into
+ * @param message The source of the message characters
+ * @param bitWidth The number of bits to use for encoding within each channel (see supportedBitWidths)
+ * @param threads The number of threads to produce and embed the message with, or 0 to use all available threads
+ * @param noiseSeed The seed of the noise that fills the image after the end of the message
+ * @param noiseLength The number of characters of noise to add after the end of the message
+ */
+void encodeMessage(cv::Mat& image, const MessageSource& message, int bitWidth, int threads = 1,
+                   uint64_t noiseSeed = std::random_device{}(), size_t noiseLength = std::numeric_limits<size_t>::max());
 
 
 /**
  * Decodes text from an image by extracting the encoded bytes from the pixel values
  * @param image The image to decode the text from
- * @param bitWidth The number of bits used for encoding within each channel (1, 2, or 4)
+ * @param bitWidth The number of bits used for encoding within each channel (see supportedBitWidths)
+ * @param threads The number of threads to extract with, or 0 to use all available threads
  * @return The decoded text
  */
-std::string decodeText(cv::Mat& image, int bitWidth);
+std::string decodeText(cv::Mat& image, int bitWidth, int threads = 1);
+
+
+/**
+ * Decodes a fixed number of characters from an image without searching for the end of the message.  Only the pixels
+ * that hold the characters are read
+ * @param image The image to decode the characters from
+ * @param bitWidth The number of bits used for encoding within each channel (see supportedBitWidths)
+ * @param index The index of the first character to decode
+ * @param count The number of characters to decode
+ * @param threads The number of threads to extract with, or 0 to use all available threads
+ * @return The decoded characters, which are fewer than count if the image ends first
+ */
+std::string decodeChars(cv::Mat& image, int bitWidth, size_t index, size_t count, int threads = 1);
+
+
+/**
+ * Gets the number of characters that can be encoded into an image
+ * @param image The image to encode into
+ * @param bitWidth The number of bits to use for encoding within each channel (see supportedBitWidths)
+ * @return The number of characters that fit within the image
+ */
+size_t textCapacity(const cv::Mat& image, int bitWidth);
 
 #endif //ICRYPT_IMAGE_ENCODE_H
@@ -0,0 +1,128 @@
+//
+// Created by matthew on 3/9/25.
+//
+
+#ifndef ICRYPT_KEYSTREAM_CACHE_H
+#define ICRYPT_KEYSTREAM_CACHE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "sha256.h"
+
+
+/**
+ * Sets the directory that keystreams are cached in.  Caching is off until a directory is set
+ * @param directory The directory to cache keystreams in, or an empty string to turn caching off
+ */
+void setKeystreamCacheDirectory(const std::string& directory);
+
+
+/**
+ * Gets the directory that keystreams are cached in
+ * @return The cache directory, or an empty string if caching is off
+ */
+const std::string& keystreamCacheDirectory();
+
+
+/**
+ * Digests a key into the digest that names and stamps its keystream cache file
+ * @param key The key to digest
+ * @return The SHA-256 digest of the key, separated from every other digest of it
+ */
+std::array<uint8_t, sha256Size> keystreamCacheDigest(const std::string& key);
+
+
+/**
+ * A keystream of per-character shifts that is stored on disk and memory-mapped, so that encoding with the same key
+ * again reads the shifts instead of generating them.  The cache only grows when a longer keystream is needed.  Every
+ * cache file is spot checked when it is opened, and each block of shifts is checked against its own checksum when it is
+ * first read, so a stale or corrupt file is rebuilt instead of being trusted without reading more of it than is needed
+ */
+class KeystreamCache {
+
+public:
+
+    /**
+     * Generates the shifts of a run of consecutive characters
+     */
+    typedef std::function<void(uint8_t* shifts, size_t index, size_t count)> Generator;
+
+private:
+
+    std::string path;
+    std::array<uint8_t, sha256Size> keyDigest;
+    Generator generate;
+    const uint8_t* mapped = nullptr;
+    size_t mappedSize = 0;
+    const uint8_t* cached = nullptr;
+    size_t cachedLength = 0;
+    size_t checkedBlocks = 0;
+
+    /**
+     * Maps the cache file into memory, checking that it belongs to the key and is intact
+     * @return True if the file was mapped, false if it is missing, stale, or corrupt
+     */
+    bool map();
+
+    /**
+     * Unmaps the cache file, if it is mapped
+     */
+    void unmap();
+
+    /**
+     * Checks a block of the mapped shifts against its checksum
+     * @param block The index of the block
+     * @return True if the block is intact
+     */
+    bool blockIntact(size_t block) const;
+
+    /**
+     * Rewrites the cache file with a longer keystream, keeping the shifts that are already cached
+     * @param length The number of shifts to write
+     * @return True if the file was written, false if it could not be
+     */
+    bool extend(size_t length);
+
+public:
+
+    /**
+     * Opens the cached keystream of a key, if one exists
+     * @param directory The directory that keystreams are cached in
+     * @param key The key that the keystream belongs to
+     * @param generate Generates the shifts that are not cached yet
+     */
+    KeystreamCache(const std::string& directory, const std::string& key, Generator generate);
+
+    /**
+     * Opens the cached keystream of a key whose digest was computed ahead of time, if one exists
+     * @param directory The directory that keystreams are cached in
+     * @param keyDigest The digest of the key from keystreamCacheDigest
+     * @param generate Generates the shifts that are not cached yet
+     */
+    KeystreamCache(const std::string& directory, const std::array<uint8_t, sha256Size>& keyDigest, Generator generate);
+
+    ~KeystreamCache();
+
+    KeystreamCache(const KeystreamCache&) = delete;
+
+    KeystreamCache& operator=(const KeystreamCache&) = delete;
+
+    /**
+     * Gets the shifts of the first characters, generating and caching any that are not cached yet
+     * @param length The number of shifts needed
+     * @return The shifts, or nullptr if the cache could not be written
+     */
+    const uint8_t* shifts(size_t length);
+
+    /**
+     * Gets the number of shifts that are cached
+     * @return The cached length
+     */
+    size_t length() const;
+};
+
+#endif //ICRYPT_KEYSTREAM_CACHE_H
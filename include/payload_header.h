@@ -0,0 +1,91 @@
+//
+// Created by matthew on 2/12/25.
+//
+
+#ifndef ICRYPT_PAYLOAD_HEADER_H
+#define ICRYPT_PAYLOAD_HEADER_H
+
+#include <cstdint>
+#include <string>
+
+
+/**
+ * The number of characters that a packed payload header takes up
+ */
+constexpr size_t payloadHeaderSize = 16;
+
+
+/**
+ * The newest payload header format version
+ */
+constexpr uint8_t payloadHeaderVersion = 1;
+
+
+/**
+ * Marks a payload of raw bytes that were embedded without being base64 encoded
+ */
+constexpr uint8_t payloadRawFlag = 1 << 0;
+
+
+/**
+ * Marks a payload that was compressed before being base64 encoded or embedded raw
+ */
+constexpr uint8_t payloadCompressedFlag = 1 << 1;
+
+
+/**
+ * Every flag that this version of the header format understands
+ */
+constexpr uint8_t payloadKnownFlags = payloadRawFlag | payloadCompressedFlag;
+
+
+/**
+ * A versioned header embedded before a payload so that decoding can read exactly the payload instead of searching the
+ * image for the end of the message
+ */
+struct PayloadHeader {
+
+    /**
+     * The format version of the header
+     */
+    uint8_t version = payloadHeaderVersion;
+
+    /**
+     * The number of bits used for encoding within each channel
+     */
+    uint8_t bitWidth = 0;
+
+    /**
+     * The identifier of the encoding the payload was encoded with
+     */
+    uint8_t encodingId = 0;
+
+    /**
+     * Flags describing how the payload was prepared
+     */
+    uint8_t flags = 0;
+
+    /**
+     * The number of characters in the payload
+     */
+    uint64_t length = 0;
+};
+
+
+/**
+ * Packs a payload header into the characters that are embedded before the payload
+ * @param header The header to pack
+ * @return The packed header, payloadHeaderSize characters long
+ */
+std::string packHeader(const PayloadHeader& header);
+
+
+/**
+ * Unpacks a payload header from the first characters embedded in an image
+ * @param packed The packed header
+ * @param header The header to unpack into
+ * @return True if the characters hold a payload header, false if they are from an image without a header
+ */
+bool unpackHeader(const std::string& packed, PayloadHeader& header);
+
+#endif //ICRYPT_PAYLOAD_HEADER_H
@@ -0,0 +1,141 @@
+//
+// Created by matthew on 3/23/25.
+//
+
+#ifndef ICRYPT_PIPELINE_H
+#define ICRYPT_PIPELINE_H
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+#include "encodings.h"
+#include "image_encode.h"
+
+
+/**
+ * The first stage of a pipeline, which produces the characters of a payload by base64 encoding the input
+ */
+struct Base64Stage {
+
+    /**
+     * Gets the number of characters that the stage produces
+     * @param inputLength The number of bytes of input
+     * @return The number of characters produced
+     */
+    static size_t length(size_t inputLength);
+
+    /**
+     * Produces a run of characters.  Runs that start or end partway through a group of base64 characters encode that
+     * whole group aside, so runs can begin anywhere
+     * @param input The whole input
+     * @param index The index of the first character to produce
+     * @param count The number of characters to produce
+     * @param out The buffer to write the characters to
+     */
+    static void produce(std::string_view input, size_t index, size_t count, char* out);
+};
+
+
+/**
+ * The first stage of a pipeline, which produces the characters of a payload as the exact bytes of the input
+ */
+struct RawStage {
+
+    static size_t length(const size_t inputLength) { return inputLength; }
+
+    static void produce(const std::string_view input, const size_t index, const size_t count, char* out) {
+        input.copy(out, count, index);
+    }
+};
+
+
+/**
+ * A pipeline stage that encodes the characters of a payload in place with an encoding
+ * @tparam Enc The type of the encoding.  Encodings are final, so calls through the exact type are not virtual
+ * @tparam Bytes Whether the payload is raw bytes, which are encoded with encodeBytesAt instead of encodeAt
+ */
+template<typename Enc, bool Bytes>
+struct EncodeStage {
+
+    const Enc& encoding;
+    const KeySchedule& schedule;
+
+    /**
+     * Encodes a run of characters in place
+     * @param chars The characters to encode
+     * @param index The index of the first character within the payload
+     * @param count The number of characters to encode
+     */
+    void apply(char* chars, const size_t index, const size_t count) const {
+        if constexpr (Bytes) encoding.encodeBytesAt(chars, count, index, schedule);
+        else encoding.encodeAt(chars, count, index, schedule);
+    }
+};
+
+
+/**
+ * A payload that is produced and transformed a block at a time as it is embedded, so the payload is never built in full
+ * and each block passes through every stage while it is still in cache.  The payload follows a prefix, such as a
+ * header, that is embedded as it is
+ * @tparam Source The stage that produces the payload characters from the input
+ * @tparam Stages The stages that transform the characters in place, in order
+ */
+template<typename Source, typename... Stages>
+class Pipeline final : public MessageSource {
+
+    std::string prefix;
+    std::string_view input;
+    std::tuple<Stages...> stages;
+
+public:
+
+    /**
+     * Creates a pipeline over an input, which must outlive the pipeline
+     * @param prefix The characters to embed before the payload
+     * @param input The input to produce the payload from
+     * @param stages The stages that transform the payload
+     */
+    Pipeline(std::string prefix, const std::string_view input, Stages... stages)
+        : prefix(std::move(prefix)), input(input), stages(stages...) {}
+
+    size_t length() const override { return prefix.length() + Source::length(input.length()); }
+
+    const char* chars(size_t index, size_t count, char* buffer) const override {
+        char* out = buffer;
+        if (index < prefix.length()) {
+            if (index + count <= prefix.length()) return prefix.data() + index;
+            const size_t prefixCount = prefix.length() - index;
+            prefix.copy(out, prefixCount, index);
+            out += prefixCount;
+            index += prefixCount;
+            count -= prefixCount;
+        }
+
+        const size_t position = index - prefix.length();
+        Source::produce(input, position, count, out);
+        std::apply([&](const Stages&... stage) { (stage.apply(out, position, count), ...); }, stages);
+        return buffer;
+    }
+};
+
+
+/**
+ * Creates the pipeline that produces a payload from its input with the given encoding.  The type of the encoding is only
+ * checked here, so the pipeline that is returned is specialized for it
+ * @param prefix The characters to embed before the payload
+ * @param input The input to produce the payload from, which must outlive the pipeline
+ * @param raw Whether to embed the exact bytes of the input instead of base64 encoding it
+ * @param enc The encoding to encode the payload with
+ * @param schedule The key schedule to encode with, which must outlive the pipeline
+ * @param threads The number of threads to encode with if the payload must be encoded in full up front, which is only
+ * the case for shiftchar with a keystream cache, or 0 to use all available threads
+ * @return The pipeline
+ */
+std::unique_ptr<MessageSource> makePipeline(std::string prefix, std::string_view input, bool raw, const Encoding* enc,
+                                            const KeySchedule& schedule, int threads = 1);
+
+#endif //ICRYPT_PIPELINE_H
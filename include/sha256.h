@@ -0,0 +1,26 @@
+//
+// Created by matthew on 3/16/25.
+//
+
+#ifndef ICRYPT_SHA256_H
+#define ICRYPT_SHA256_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+
+/**
+ * The number of bytes in a SHA-256 digest
+ */
+constexpr size_t sha256Size = 32;
+
+
+/**
+ * Computes the SHA-256 digest of some data, as specified in FIPS 180-4
+ * @param data The data to digest
+ * @return The digest
+ */
+std::array<uint8_t, sha256Size> sha256(std::string_view data);
+
+#endif //ICRYPT_SHA256_H
@@ -0,0 +1,44 @@
+//
+// Created by matthew on 2/9/25.
+//
+
+#ifndef ICRYPT_TAIL_NOISE_H
+#define ICRYPT_TAIL_NOISE_H
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * Generates the random base64 characters that disguise the end of a message.  Each character only depends on the seed
+ * and its index, so any range of characters can be generated independently and from any number of threads
+ */
+class TailNoise {
+
+    uint64_t seed;
+
+public:
+
+    /**
+     * Creates a noise generator
+     * @param seed The seed to generate the noise from
+     */
+    explicit TailNoise(uint64_t seed);
+
+    /**
+     * Gets a single noise character
+     * @param index The index of the character
+     * @return The noise character at the given index
+     */
+    char at(size_t index) const;
+
+    /**
+     * Fills a buffer with a run of consecutive noise characters
+     * @param chars The buffer to fill
+     * @param index The index of the first character
+     * @param count The number of characters to generate
+     */
+    void fill(char* chars, size_t index, size_t count) const;
+};
+
+#endif //ICRYPT_TAIL_NOISE_H
@@ -0,0 +1,290 @@
+//
+// Created by matthew on 3/16/25.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "aes_ctr.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ICRYPT_X86_KERNELS
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+
+/**
+ * The number of rounds of AES-256
+ */
+static constexpr int aesRounds = 14;
+
+
+/**
+ * The most blocks that a kernel encrypts at once.  Encrypting several independent blocks together hides the latency of
+ * each round
+ */
+static constexpr size_t kernelBlocks = 8;
+
+
+/**
+ * Encrypts blocks in place with an expanded key
+ */
+typedef void (*EncryptKernel)(const uint8_t* roundKeys, uint8_t* blocks, size_t count);
+
+
+// Bitsliced software kernel.  The S-box is computed with boolean gates on 64 bytes at once instead of being looked up in
+// a table, so no memory access depends on the key or the data
+
+/**
+ * The number of bytes that are substituted at once, which is four blocks
+ */
+static constexpr size_t slicedBytes = 64;
+
+
+/**
+ * Transposes an 8x8 matrix of bits, where each byte is a row.  Bit c of byte r becomes bit r of byte c
+ */
+static uint64_t transpose8(uint64_t x) {
+    uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AA;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCC;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0;
+    return x ^ t ^ (t << 28);
+}
+
+
+/**
+ * Splits 64 bytes into 8 bit planes, where bit i of plane j is bit j of byte i
+ */
+static void toPlanes(const uint8_t* bytes, uint64_t planes[8]) {
+    std::fill(planes, planes + 8, 0);
+    for (int word = 0; word < 8; word++) {
+        uint64_t rows = 0;
+        for (int i = 0; i < 8; i++) rows |= static_cast<uint64_t>(bytes[word * 8 + i]) << (i * 8);
+        const uint64_t columns = transpose8(rows);
+        for (int j = 0; j < 8; j++) planes[j] |= (columns >> (j * 8) & 0xFF) << (word * 8);
+    }
+}
+
+
+/**
+ * Joins 8 bit planes back into 64 bytes
+ */
+static void fromPlanes(const uint64_t planes[8], uint8_t* bytes) {
+    for (int word = 0; word < 8; word++) {
+        uint64_t columns = 0;
+        for (int j = 0; j < 8; j++) columns |= (planes[j] >> (word * 8) & 0xFF) << (j * 8);
+        const uint64_t rows = transpose8(columns);
+        for (int i = 0; i < 8; i++) bytes[word * 8 + i] = static_cast<uint8_t>(rows >> (i * 8));
+    }
+}
+
+
+/**
+ * Applies the AES S-box to 64 bytes at once, using the 113-gate circuit of Boyar and Peralta on their bit planes
+ */
+static void subBytes(uint8_t* bytes) {
+    uint64_t q[8];
+    toPlanes(bytes, q);
+
+    const uint64_t x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4], x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+    // Top linear transformation
+    const uint64_t y14 = x3 ^ x5, y13 = x0 ^ x6, y9 = x0 ^ x3, y8 = x0 ^ x5, t0 = x1 ^ x2, y1 = t0 ^ x7;
+    const uint64_t y4 = y1 ^ x3, y12 = y13 ^ y14, y2 = y1 ^ x0, y5 = y1 ^ x6, y3 = y5 ^ y8, t1 = x4 ^ y12;
+    const uint64_t y15 = t1 ^ x5, y20 = t1 ^ x1, y6 = y15 ^ x7, y10 = y15 ^ t0, y11 = y20 ^ y9, y7 = x7 ^ y11;
+    const uint64_t y17 = y10 ^ y11, y19 = y10 ^ y8, y16 = t0 ^ y11, y21 = y13 ^ y16, y18 = x0 ^ y16;
+
+    // Shared non-linear section
+    const uint64_t t2 = y12 & y15, t3 = y3 & y6, t4 = t3 ^ t2, t5 = y4 & x7, t6 = t5 ^ t2, t7 = y13 & y16;
+    const uint64_t t8 = y5 & y1, t9 = t8 ^ t7, t10 = y2 & y7, t11 = t10 ^ t7, t12 = y9 & y11, t13 = y14 & y17;
+    const uint64_t t14 = t13 ^ t12, t15 = y8 & y10, t16 = t15 ^ t12, t17 = t4 ^ t14, t18 = t6 ^ t16, t19 = t9 ^ t14;
+    const uint64_t t20 = t11 ^ t16, t21 = t17 ^ y20, t22 = t18 ^ y19, t23 = t19 ^ y21, t24 = t20 ^ y18;
+    const uint64_t t25 = t21 ^ t22, t26 = t21 & t23, t27 = t24 ^ t26, t28 = t25 & t27, t29 = t28 ^ t22, t30 = t23 ^ t24;
+    const uint64_t t31 = t22 ^ t26, t32 = t31 & t30, t33 = t32 ^ t24, t34 = t23 ^ t33, t35 = t27 ^ t33, t36 = t24 & t35;
+    const uint64_t t37 = t36 ^ t34, t38 = t27 ^ t36, t39 = t29 & t38, t40 = t25 ^ t39;
+    const uint64_t t41 = t40 ^ t37, t42 = t29 ^ t33, t43 = t29 ^ t40, t44 = t33 ^ t37, t45 = t42 ^ t41;
+    const uint64_t z0 = t44 & y15, z1 = t37 & y6, z2 = t33 & x7, z3 = t43 & y16, z4 = t40 & y1, z5 = t29 & y7;
+    const uint64_t z6 = t42 & y11, z7 = t45 & y17, z8 = t41 & y10, z9 = t44 & y12, z10 = t37 & y3, z11 = t33 & y4;
+    const uint64_t z12 = t43 & y13, z13 = t40 & y5, z14 = t29 & y2, z15 = t42 & y9, z16 = t45 & y14, z17 = t41 & y8;
+
+    // Bottom linear transformation
+    const uint64_t t46 = z15 ^ z16, t47 = z10 ^ z11, t48 = z5 ^ z13, t49 = z9 ^ z10, t50 = z2 ^ z12, t51 = z2 ^ z5;
+    const uint64_t t52 = z7 ^ z8, t53 = z0 ^ z3, t54 = z6 ^ z7, t55 = z16 ^ z17, t56 = z12 ^ t48, t57 = t50 ^ t53;
+    const uint64_t t58 = z4 ^ t46, t59 = z3 ^ t54, t60 = t46 ^ t57, t61 = z14 ^ t57, t62 = t52 ^ t58, t63 = t49 ^ t58;
+    const uint64_t t64 = z4 ^ t59, t65 = t61 ^ t62, t66 = z1 ^ t63, t67 = t64 ^ t65;
+    const uint64_t s3 = t53 ^ t66;
+    q[7] = t59 ^ t63;
+    q[6] = t64 ^ ~s3;
+    q[5] = t55 ^ ~t67;
+    q[4] = s3;
+    q[3] = t51 ^ t66;
+    q[2] = t47 ^ t65;
+    q[1] = t56 ^ ~t62;
+    q[0] = t48 ^ ~t60;
+
+    fromPlanes(q, bytes);
+}
+
+
+/**
+ * Multiplies a byte by x in the AES field, without branching on its value
+ */
+static uint8_t xtime(const uint8_t byte) { return static_cast<uint8_t>(byte << 1 ^ (byte >> 7) * 0x1B); }
+
+
+/**
+ * Applies ShiftRows and MixColumns to a block, whose bytes are stored column by column
+ */
+static void shiftAndMix(uint8_t* block) {
+    uint8_t shifted[aesBlockSize];
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 4; row++) shifted[column * 4 + row] = block[(column + row) % 4 * 4 + row];
+
+    for (int column = 0; column < 4; column++) {
+        const uint8_t* a = shifted + column * 4;
+        const uint8_t all = a[0] ^ a[1] ^ a[2] ^ a[3];
+        for (int row = 0; row < 4; row++) block[column * 4 + row] = a[row] ^ all ^ xtime(a[row] ^ a[(row + 1) % 4]);
+    }
+}
+
+
+/**
+ * Applies ShiftRows to a block, for the last round which skips MixColumns
+ */
+static void shiftRows(uint8_t* block) {
+    uint8_t shifted[aesBlockSize];
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 4; row++) shifted[column * 4 + row] = block[(column + row) % 4 * 4 + row];
+    memcpy(block, shifted, aesBlockSize);
+}
+
+
+static void encryptSoftware(const uint8_t* roundKeys, uint8_t* blocks, size_t count) {
+    for (; count > 0; blocks += slicedBytes) {
+        const size_t sliced = std::min(count, slicedBytes / aesBlockSize);
+        uint8_t state[slicedBytes] = {};
+        memcpy(state, blocks, sliced * aesBlockSize);
+
+        for (size_t i = 0; i < slicedBytes; i++) state[i] ^= roundKeys[i % aesBlockSize];
+        for (int round = 1; round <= aesRounds; round++) {
+            subBytes(state);
+            for (size_t block = 0; block < slicedBytes; block += aesBlockSize) {
+                if (round < aesRounds) shiftAndMix(state + block);
+                else shiftRows(state + block);
+            }
+            for (size_t i = 0; i < slicedBytes; i++) state[i] ^= roundKeys[round * aesBlockSize + i % aesBlockSize];
+        }
+
+        memcpy(blocks, state, sliced * aesBlockSize);
+        count -= sliced;
+    }
+}
+
+
+#ifdef ICRYPT_X86_KERNELS
+
+// AES-NI kernel
+
+#define ICRYPT_AESNI __attribute__((target("aes,sse2")))
+
+ICRYPT_AESNI static void encryptAesNi(const uint8_t* roundKeys, uint8_t* blocks, const size_t count) {
+    __m128i keys[aesRounds + 1];
+    for (int round = 0; round <= aesRounds; round++)
+        keys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys + round * aesBlockSize));
+
+    __m128i state[kernelBlocks];
+    for (size_t i = 0; i < count; i++)
+        state[i] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i * aesBlockSize)), keys[0]);
+    for (int round = 1; round < aesRounds; round++)
+        for (size_t i = 0; i < count; i++) state[i] = _mm_aesenc_si128(state[i], keys[round]);
+    for (size_t i = 0; i < count; i++)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(blocks + i * aesBlockSize), _mm_aesenclast_si128(state[i], keys[aesRounds]));
+}
+
+
+/**
+ * Checks whether the CPU has the AES-NI instructions
+ */
+static bool aesNiSupported() {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES);
+}
+
+#endif
+
+
+AesCtr::AesCtr(const std::array<uint8_t, aesKeySize>& key, const std::array<uint8_t, aesBlockSize>& counter,
+               const bool allowHardware) : roundKeys(), counterHigh(0), counterLow(0), hardware(false) {
+
+    // Expand the key 4 bytes at a time, substituting every fourth word
+    memcpy(roundKeys.data(), key.data(), aesKeySize);
+    uint8_t roundConstant = 1;
+    for (size_t i = aesKeySize; i < roundKeys.size(); i += 4) {
+        uint8_t word[slicedBytes] = {};
+        memcpy(word, roundKeys.data() + i - 4, 4);
+        if (i % aesKeySize == 0) {
+            std::rotate(word, word + 1, word + 4);
+            subBytes(word);
+            word[0] ^= roundConstant;
+            roundConstant = xtime(roundConstant);
+        } else if (i % aesKeySize == 16) subBytes(word);
+        for (int j = 0; j < 4; j++) roundKeys[i + j] = roundKeys[i + j - aesKeySize] ^ word[j];
+    }
+
+    for (int i = 0; i < 8; i++) {
+        counterHigh = counterHigh << 8 | counter[i];
+        counterLow = counterLow << 8 | counter[i + 8];
+    }
+
+#ifdef ICRYPT_X86_KERNELS
+    hardware = allowHardware && aesNiSupported();
+#endif
+}
+
+
+void AesCtr::apply(char* data, size_t length, const size_t position) const {
+#ifdef ICRYPT_X86_KERNELS
+    const EncryptKernel encrypt = hardware ? encryptAesNi : encryptSoftware;
+#else
+    const EncryptKernel encrypt = encryptSoftware;
+#endif
+
+    uint8_t stream[kernelBlocks * aesBlockSize];
+    size_t block = position / aesBlockSize;
+    size_t offset = position % aesBlockSize;
+    while (length > 0) {
+        // Fill the counter blocks, carrying from the low half into the high half
+        const size_t count = std::min(kernelBlocks, (offset + length + aesBlockSize - 1) / aesBlockSize);
+        for (size_t i = 0; i < count; i++) {
+            const uint64_t low = counterLow + block + i;
+            const uint64_t high = counterHigh + (low < counterLow);
+            for (int j = 0; j < 8; j++) {
+                stream[i * aesBlockSize + j] = static_cast<uint8_t>(high >> (56 - j * 8));
+                stream[i * aesBlockSize + 8 + j] = static_cast<uint8_t>(low >> (56 - j * 8));
+            }
+        }
+        encrypt(roundKeys.data(), stream, count);
+
+        const size_t used = std::min(count * aesBlockSize - offset, length);
+        for (size_t i = 0; i < used; i++) data[i] = static_cast<char>(data[i] ^ stream[offset + i]);
+        data += used;
+        length -= used;
+        block += count;
+        offset = 0;
+    }
+}
+
+
+void AesCtr::encryptBlock(const uint8_t* in, uint8_t* out) const {
+    memcpy(out, in, aesBlockSize);
+#ifdef ICRYPT_X86_KERNELS
+    if (hardware) {
+        encryptAesNi(roundKeys.data(), out, 1);
+        return;
+    }
+#endif
+    encryptSoftware(roundKeys.data(), out, 1);
+}
@@ -2,51 +2,395 @@
 // Created by matthew on 4/30/24.
 //
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <string>
-#include <opencv2/core/hal/interface.h>
 #include <vector>
+#include <opencv2/core/hal/interface.h>
+#include <opencv2/core/utility.hpp>
 #include <iostream>
 
 #include "base64.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ICRYPT_X86_KERNELS
+#include <immintrin.h>
+#endif
 
-std::string base64Encode(const std::string& in) {
 
-    std::string out;
+/**
+ * The base64 alphabet, indexed by 6-bit value
+ */
+static constexpr char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-    int val = 0, valb = -6;
-    for (const uchar c : in) {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0) {
-            out.push_back("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
+
+/**
+ * Builds the table of the 6-bit value of each base64 character
+ * @return The table, indexed by character, holding -1 for characters outside of the alphabet
+ */
+static constexpr std::array<int8_t, 256> makeDecodeTable() {
+    std::array<int8_t, 256> table{};
+    for (int8_t& value : table) value = -1;
+    for (int i = 0; i < 64; i++) table[static_cast<uchar>(base64Chars[i])] = static_cast<int8_t>(i);
+    return table;
+}
+
+static constexpr std::array<int8_t, 256> base64Values = makeDecodeTable();
+
+
+/**
+ * The fewest groups that are given to each thread when encoding or decoding in parallel
+ */
+static constexpr size_t minChunkGroups = 1 << 16;
+
+
+/**
+ * Encodes whole groups of 3 bytes into groups of 4 base64 characters
+ * @param in The bytes to encode
+ * @param groups The number of groups to encode
+ * @param out The buffer to write 4 characters per group to
+ */
+typedef void (*EncodeBlocks)(const uchar* in, size_t groups, char* out);
+
+
+/**
+ * Decodes groups of 4 base64 characters into groups of 3 bytes, stopping before the first block of groups that holds a
+ * character outside of the alphabet
+ * @param in The characters to decode
+ * @param groups The number of groups to decode
+ * @param out The buffer to write 3 bytes per group to
+ * @return The number of groups decoded
+ */
+typedef size_t (*DecodeBlocks)(const char* in, size_t groups, uchar* out);
+
+
+// Scalar kernels
+
+static void encodeScalar(const uchar* in, const size_t groups, char* out) {
+    for (size_t i = 0; i < groups; i++, in += 3, out += 4) {
+        const uint32_t bits = in[0] << 16 | in[1] << 8 | in[2];
+        out[0] = base64Chars[bits >> 18];
+        out[1] = base64Chars[bits >> 12 & 0x3F];
+        out[2] = base64Chars[bits >> 6 & 0x3F];
+        out[3] = base64Chars[bits & 0x3F];
     }
-    if (valb > -6) out.push_back("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[((val << 8) >> (valb + 8)) & 0x3F]);
-    while (out.size() % 4) out.push_back('=');
-    return out;
 }
 
-std::string base64Decode(const std::string& in) {
+static size_t decodeScalar(const char* in, const size_t groups, uchar* out) {
+    for (size_t i = 0; i < groups; i++, in += 4, out += 3) {
+        const int8_t a = base64Values[static_cast<uchar>(in[0])], b = base64Values[static_cast<uchar>(in[1])];
+        const int8_t c = base64Values[static_cast<uchar>(in[2])], d = base64Values[static_cast<uchar>(in[3])];
+        if ((a | b | c | d) < 0) return i;
+        const uint32_t bits = a << 18 | b << 12 | c << 6 | d;
+        out[0] = static_cast<uchar>(bits >> 16);
+        out[1] = static_cast<uchar>(bits >> 8);
+        out[2] = static_cast<uchar>(bits);
+    }
+    return groups;
+}
+
+
+#ifdef ICRYPT_X86_KERNELS
+
+// SSE4.1 kernels, based on the vectorized base64 designs of Wojciech Muła and Daniel Lemire
+
+#define ICRYPT_SSE41 __attribute__((target("sse4.1")))
+
+/**
+ * Splits 4 groups of 3 bytes into 16 6-bit values, one per byte
+ */
+ICRYPT_SSE41 static __m128i encodeReshuffle(__m128i in) {
+    // Each group [a b c] becomes [b a c b], so that each 6-bit value can be moved into place with 16-bit multiplies
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m128i high = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    const __m128i low = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(high, low);
+}
+
+/**
+ * Translates 16 6-bit values into base64 characters by adding the offset of the range each value falls into
+ */
+ICRYPT_SSE41 static __m128i encodeTranslate(const __m128i values) {
+    const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m128i range = _mm_subs_epu8(values, _mm_set1_epi8(51));
+    range = _mm_sub_epi8(range, _mm_cmpgt_epi8(values, _mm_set1_epi8(25)));
+    return _mm_add_epi8(values, _mm_shuffle_epi8(offsets, range));
+}
+
+ICRYPT_SSE41 static void encodeSse41(const uchar* in, const size_t groups, char* out) {
+    size_t i = 0;
+    for (; i + 6 <= groups; i += 4, in += 12, out += 16) {  // Each load reads 4 bytes past the 4 groups it encodes
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), encodeTranslate(encodeReshuffle(bytes)));
+    }
+    encodeScalar(in, groups - i, out);
+}
+
+/**
+ * Translates 16 base64 characters into their 6-bit values
+ * @param chars The characters to translate
+ * @param values The 6-bit values
+ * @return True if every character is within the alphabet
+ */
+ICRYPT_SSE41 static bool decodeTranslate(const __m128i chars, __m128i& values) {
+    const __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), _mm_set1_epi8(0x0F));
+    const __m128i lowNibbles = _mm_and_si128(chars, _mm_set1_epi8(0x0F));
+
+    // Each low nibble selects the set of high nibbles that form valid characters with it
+    const __m128i validHighNibbles = _mm_setr_epi8(
+        static_cast<char>(0xA8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+        static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+        static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF0), 0x54, 0x50, 0x50, 0x50, 0x54);
+    const __m128i highNibbleBits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i valid = _mm_and_si128(_mm_shuffle_epi8(validHighNibbles, lowNibbles),
+                                        _mm_shuffle_epi8(highNibbleBits, highNibbles));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128()))) return false;
+
+    // Each high nibble selects the offset of its range, except for '/' which shares its high nibble with '+'
+    const __m128i offsets = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+    const __m128i offset = _mm_blendv_epi8(_mm_shuffle_epi8(offsets, highNibbles), _mm_set1_epi8(16), slash);
+    values = _mm_add_epi8(chars, offset);
+    return true;
+}
+
+/**
+ * Packs 16 6-bit values into 12 bytes at the start of the register
+ */
+ICRYPT_SSE41 static __m128i decodePack(const __m128i values) {
+    const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+ICRYPT_SSE41 static size_t decodeSse41(const char* in, const size_t groups, uchar* out) {
+    size_t i = 0;
+    for (; i + 4 <= groups; i += 4, in += 16, out += 12) {
+        __m128i values;
+        if (!decodeTranslate(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), values)) break;
+        const __m128i bytes = decodePack(values);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+        const uint32_t last = _mm_extract_epi32(bytes, 2);
+        memcpy(out + 8, &last, 4);
+    }
+    return i + decodeScalar(in, groups - i, out);
+}
+
+
+// AVX2 kernels, processing two SSE4.1 blocks per instruction
+
+#define ICRYPT_AVX2 __attribute__((target("avx2")))
+
+ICRYPT_AVX2 static void encodeAvx2(const uchar* in, const size_t groups, char* out) {
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+                                             65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    size_t i = 0;
+    for (; i + 10 <= groups; i += 8, in += 24, out += 32) {  // The second load reads 4 bytes past the 8 groups
+        __m256i bytes = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12)), 1);
+        bytes = _mm256_shuffle_epi8(bytes, shuffle);
+        const __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0FC0FC00)),
+                                                _mm256_set1_epi32(0x04000040));
+        const __m256i low = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003F03F0)),
+                                               _mm256_set1_epi32(0x01000010));
+        const __m256i values = _mm256_or_si256(high, low);
+
+        __m256i range = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+        range = _mm256_sub_epi8(range, _mm256_cmpgt_epi8(values, _mm256_set1_epi8(25)));
+        const __m256i chars = _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, range));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), chars);
+    }
+    encodeSse41(in, groups - i, out);
+}
+
+ICRYPT_AVX2 static size_t decodeAvx2(const char* in, const size_t groups, uchar* out) {
+    const __m256i validHighNibbles = _mm256_setr_epi8(
+        static_cast<char>(0xA8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+        static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+        static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF0), 0x54, 0x50, 0x50, 0x50, 0x54,
+        static_cast<char>(0xA8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+        static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+        static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF0), 0x54, 0x50, 0x50, 0x50, 0x54);
+    const __m256i highNibbleBits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                    1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i offsets = _mm256_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 8 <= groups; i += 8, in += 32, out += 24) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), _mm256_set1_epi8(0x0F));
+        const __m256i lowNibbles = _mm256_and_si256(chars, _mm256_set1_epi8(0x0F));
+        const __m256i valid = _mm256_and_si256(_mm256_shuffle_epi8(validHighNibbles, lowNibbles),
+                                               _mm256_shuffle_epi8(highNibbleBits, highNibbles));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(valid, _mm256_setzero_si256()))) break;
+
+        const __m256i slash = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'));
+        const __m256i offset = _mm256_blendv_epi8(_mm256_shuffle_epi8(offsets, highNibbles), _mm256_set1_epi8(16), slash);
+        const __m256i values = _mm256_add_epi8(chars, offset);
+
+        const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i bytes = _mm256_shuffle_epi8(_mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000)), pack);
+        bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));  // Join the lanes
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(bytes));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16), _mm256_extracti128_si256(bytes, 1));
+    }
+    return i + decodeSse41(in, groups - i, out);
+}
+
+#endif
+
+
+/**
+ * Selects the fastest base64 kernels supported by the current CPU.  The CPU is only checked on the first call
+ * @return The encoding and decoding kernels
+ */
+static std::pair<EncodeBlocks, DecodeBlocks> base64Kernels() {
+    typedef std::pair<EncodeBlocks, DecodeBlocks> Kernels;
+    static const Kernels kernels = [] {
+#ifdef ICRYPT_X86_KERNELS
+        if (cv::checkHardwareSupport(CV_CPU_AVX2)) return Kernels(encodeAvx2, decodeAvx2);
+        if (cv::checkHardwareSupport(CV_CPU_SSE4_1)) return Kernels(encodeSse41, decodeSse41);
+#endif
+        return Kernels(encodeScalar, decodeScalar);
+    }();
+    return kernels;
+}
+
+
+/**
+ * Gets the number of chunks to split a run of groups into for the given number of threads.  Chunks are kept large
+ * enough that splitting them is worth the cost of starting the threads
+ * @param groups The number of groups to split
+ * @param threads The requested number of threads, or 0 to use all available threads
+ * @return The number of chunks
+ */
+static size_t chunkCount(const size_t groups, const int threads) {
+    const size_t maxChunks = threads > 0 ? threads : std::max(cv::getNumThreads(), 1);
+    return std::max<size_t>(std::min(maxChunks, groups / minChunkGroups), 1);
+}
+
+
+/**
+ * Encodes whole groups of bytes, splitting them into chunks that are encoded in parallel
+ * @param in The bytes to encode
+ * @param groups The number of groups to encode
+ * @param out The buffer to write 4 characters per group to
+ * @param threads The number of threads to encode with, or 0 to use all available threads
+ */
+static void encodeChunks(const uchar* in, const size_t groups, char* out, const int threads) {
+    const EncodeBlocks encode = base64Kernels().first;
+    const size_t chunks = chunkCount(groups, threads);
+    if (chunks == 1) {
+        encode(in, groups, out);
+        return;
+    }
+
+    // Every group is encoded independently, so each chunk writes straight to its place in the output
+    cv::parallel_for_(cv::Range(0, static_cast<int>(chunks)), [&](const cv::Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++) {
+            const size_t begin = groups * chunk / chunks, end = groups * (chunk + 1) / chunks;
+            encode(in + begin * 3, end - begin, out + begin * 4);
+        }
+    }, static_cast<double>(chunks));
+}
 
-    std::string out;
 
-    std::vector<int> T(256, -1);
-    for (int i = 0; i<64; i++) T["ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[i]] = i;
+/**
+ * Decodes whole groups of characters, splitting them into chunks that are decoded in parallel
+ * @param in The characters to decode
+ * @param groups The number of groups to decode
+ * @param out The buffer to write 3 bytes per group to
+ * @param threads The number of threads to decode with, or 0 to use all available threads
+ * @return The number of groups decoded before the first group that holds a character outside of the alphabet
+ */
+static size_t decodeChunks(const char* in, const size_t groups, uchar* out, const int threads) {
+    const DecodeBlocks decode = base64Kernels().second;
+    const size_t chunks = chunkCount(groups, threads);
+    if (chunks == 1) return decode(in, groups, out);
 
-    int val = 0, valb = -8;
-    for (const uchar c : in) {
-        if (T[c] == -1) {
-            if (c != '=' && c != '\0') std::cerr << "Warning: Text may be truncated or corrupted!" << std::endl;
-            break;
+    std::vector<size_t> decoded(chunks);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(chunks)), [&](const cv::Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++) {
+            const size_t begin = groups * chunk / chunks, end = groups * (chunk + 1) / chunks;
+            decoded[chunk] = begin + decode(in + begin * 4, end - begin, out + begin * 3);
         }
-        val = (val << 6) + T[c];
-        valb += 6;
-        if (valb >= 0) {
-            out.push_back(static_cast<char>((val >> valb) & 0xFF));
-            valb -= 8;
+    }, static_cast<double>(chunks));
+
+    // Decoding ends at the first chunk that stopped early, and anything decoded by later chunks is dropped
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+        if (decoded[chunk] < groups * (chunk + 1) / chunks) return decoded[chunk];
+    return groups;
+}
+
+
+size_t base64EncodedSize(const size_t length) { return (length + 2) / 3 * 4; }
+
+size_t base64DecodedSize(const size_t length) { return length / 4 * 3 + (length % 4 >= 2 ? length % 4 - 1 : 0); }
+
+size_t base64Encode(const std::string_view in, char* out, const int threads) {
+
+    const auto* bytes = reinterpret_cast<const uchar*>(in.data());
+    const size_t groups = in.length() / 3;
+    encodeChunks(bytes, groups, out, threads);
+
+    // Encode the last 1 or 2 bytes, then pad them
+    const size_t remaining = in.length() - groups * 3;
+    if (remaining > 0) {
+        const uint32_t bits = bytes[groups * 3] << 16 | (remaining == 2 ? bytes[groups * 3 + 1] << 8 : 0);
+        char* last = out + groups * 4;
+        last[0] = base64Chars[bits >> 18];
+        last[1] = base64Chars[bits >> 12 & 0x3F];
+        last[2] = remaining == 2 ? base64Chars[bits >> 6 & 0x3F] : '=';
+        last[3] = '=';
+    }
+    return base64EncodedSize(in.length());
+}
+
+size_t base64Decode(const std::string_view in, char* out, const int threads) {
+
+    auto* bytes = reinterpret_cast<uchar*>(out);
+    const size_t decoded = decodeChunks(in.data(), in.length() / 4, bytes, threads) * 4;
+
+    // Find the end of the base64 characters within the rest of the text
+    size_t end = decoded;
+    while (end < in.length() && base64Values[static_cast<uchar>(in[end])] != -1) end++;
+    if (end < in.length() && in[end] != '=' && in[end] != '\0')
+        std::cerr << "Warning: Text may be truncated or corrupted!" << std::endl;
+
+    // Decode the rest of the characters, including a final partial group
+    uint32_t bits = 0;
+    size_t length = decoded / 4 * 3;
+    for (size_t i = decoded; i < end; i++) {
+        bits = bits << 6 | base64Values[static_cast<uchar>(in[i])];
+        if ((i - decoded) % 4 == 3) {
+            bytes[length++] = static_cast<uchar>(bits >> 16);
+            bytes[length++] = static_cast<uchar>(bits >> 8);
+            bytes[length++] = static_cast<uchar>(bits);
         }
     }
+    const size_t partial = (end - decoded) % 4;
+    if (partial >= 2) bytes[length++] = static_cast<uchar>(bits >> (partial * 6 - 8));
+    if (partial == 3) bytes[length++] = static_cast<uchar>(bits >> 2);
+
+    return length;
+}
+
+std::string base64Encode(const std::string_view in, const int threads) {
+    std::string out(base64EncodedSize(in.length()), '\0');
+    base64Encode(in, out.data(), threads);
     return out;
-}
\ No newline at end of file
+}
+
+std::string base64Decode(const std::string_view in, const int threads) {
+    // Allocate for the longest possible output, then shrink to the bytes that were decoded
+    std::string out(base64DecodedSize(in.length()), '\0');
+    out.resize(base64Decode(in, out.data(), threads));
+    return out;
+}
@@ -0,0 +1,146 @@
+//
+// Created by matthew on 3/2/25.
+//
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/core/utility.hpp>
+#include <zlib.h>
+
+#include "compression.h"
+
+
+/**
+ * The number of payload bytes in each segment that is compressed on its own thread.  The segments do not depend on the
+ * number of threads, so neither does the compressed payload
+ */
+static constexpr size_t compressSegment = 1 << 20;
+
+
+/**
+ * The number of bytes that deflate can refer back to, which each segment is primed with from the end of the last one
+ */
+static constexpr size_t deflateWindow = 1 << 15;
+
+
+/**
+ * The deflate memory level, which is the zlib default that compress2 uses
+ */
+static constexpr int deflateMemLevel = 8;
+
+
+/**
+ * The number of bytes to grow the output by each time decompression fills it
+ */
+static constexpr size_t decompressChunk = 1 << 16;
+
+
+/**
+ * Compresses a segment of a payload into raw deflate data, as if it continued the segments before it
+ * @param payload The whole payload
+ * @param begin The index of the first byte of the segment
+ * @param end The index past the last byte of the segment
+ * @param level The compression level
+ * @return The raw deflate data of the segment, which ends on a byte boundary
+ */
+static std::string compressSegmentOf(const std::string& payload, const size_t begin, const size_t end, const int level) {
+
+    z_stream stream{};
+    deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, deflateMemLevel, Z_DEFAULT_STRATEGY);
+
+    // Let the segment refer back into the previous one, as a single deflate stream would
+    const size_t dictionary = std::min(begin, deflateWindow);
+    if (dictionary > 0)
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(payload.data() + begin - dictionary), dictionary);
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.data() + begin));
+    stream.avail_in = end - begin;
+
+    // Only the last segment ends the stream.  Every other segment is flushed to a byte boundary so they can be joined
+    const int flush = end == payload.length() ? Z_FINISH : Z_SYNC_FLUSH;
+    const size_t bound = deflateBound(&stream, end - begin) + 8;
+    std::string compressed;
+    int status = Z_OK;
+    while (status == Z_OK) {
+        const size_t written = compressed.length();
+        compressed.resize(written + bound);
+        stream.next_out = reinterpret_cast<Bytef*>(compressed.data() + written);
+        stream.avail_out = bound;
+        status = deflate(&stream, flush);
+        compressed.resize(compressed.length() - stream.avail_out);
+        if (flush == Z_SYNC_FLUSH && stream.avail_out > 0) break;
+    }
+    deflateEnd(&stream);
+
+    return compressed;
+}
+
+
+std::string compressPayload(const std::string& payload, const int level, const int threads) {
+
+    const size_t segments = std::max<size_t>((payload.length() + compressSegment - 1) / compressSegment, 1);
+    std::vector<std::string> pieces(segments);
+    std::vector<uLong> checksums(segments);
+    const auto compressSegments = [&](const cv::Range& range) {
+        for (int segment = range.start; segment < range.end; segment++) {
+            const size_t begin = segment * compressSegment;
+            const size_t end = std::min(payload.length(), begin + compressSegment);
+            pieces[segment] = compressSegmentOf(payload, begin, end, level);
+            checksums[segment] = adler32(adler32(0, nullptr, 0), reinterpret_cast<const Bytef*>(payload.data() + begin),
+                                         end - begin);
+        }
+    };
+    const int chunks = static_cast<int>(std::min<size_t>(segments, threads > 0 ? threads : std::max(cv::getNumThreads(), 1)));
+    if (chunks == 1) compressSegments(cv::Range(0, static_cast<int>(segments)));
+    else cv::parallel_for_(cv::Range(0, static_cast<int>(segments)), compressSegments, chunks);
+
+    // Wrap the joined segments in the same zlib header and checksum that compress2 writes
+    const int levelFlags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    const unsigned int header = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8 | levelFlags << 6;
+    std::string compressed;
+    compressed += static_cast<char>((header + 31 - header % 31) >> 8);
+    compressed += static_cast<char>((header + 31 - header % 31) & 0xFF);
+
+    uLong checksum = checksums[0];
+    for (size_t segment = 0; segment < segments; segment++) {
+        compressed += pieces[segment];
+        std::string().swap(pieces[segment]);
+        if (segment > 0) {
+            const size_t length = std::min(payload.length() - segment * compressSegment, compressSegment);
+            checksum = adler32_combine(checksum, checksums[segment], static_cast<z_off_t>(length));
+        }
+    }
+    for (int shift = 24; shift >= 0; shift -= 8) compressed += static_cast<char>(checksum >> shift & 0xFF);
+
+    return compressed;
+}
+
+
+bool decompressPayload(const std::string& compressed, std::string& payload, const size_t maxLength) {
+
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) return false;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    size_t unread = compressed.length();
+
+    // The decompressed length is not stored, so grow the output until the stream ends or passes the longest payload
+    payload.clear();
+    int status = Z_OK;
+    while (status == Z_OK && payload.length() <= maxLength) {
+        // zlib takes the length as an unsigned int, so large payloads are fed in pieces
+        if (stream.avail_in == 0) {
+            stream.avail_in = static_cast<uInt>(std::min<size_t>(unread, 1u << 30));
+            unread -= stream.avail_in;
+        }
+
+        const size_t written = payload.length();
+        payload.resize(written + decompressChunk);
+        stream.next_out = reinterpret_cast<Bytef*>(payload.data() + written);
+        stream.avail_out = decompressChunk;
+        status = inflate(&stream, Z_NO_FLUSH);
+        payload.resize(payload.length() - stream.avail_out);
+    }
+    inflateEnd(&stream);
+
+    return status == Z_STREAM_END && payload.length() <= maxLength;
+}
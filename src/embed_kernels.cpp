@@ -0,0 +1,643 @@
+//
+// Created by matthew on 2/3/25.
+//
+
+#include "embed_kernels.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <opencv2/core/utility.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ICRYPT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define ICRYPT_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+
+/**
+ * The bits of each 4-bit value in reverse order, used by the 4-bit layout
+ */
+alignas(16) static constexpr uchar reversedNibbles[16] = {
+    0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
+};
+
+
+/**
+ * Builds a table of the channel values that encode each character
+ * @tparam Channels The number of channels used to encode a character
+ * @param spread Writes the channel values for a character to the given channels
+ * @return The table, indexed by character
+ */
+template<size_t Channels, typename Spread>
+constexpr std::array<std::array<uchar, Channels>, 256> makeSpreadTable(Spread spread) {
+    std::array<std::array<uchar, Channels>, 256> table{};
+    for (int c = 0; c < 256; c++) spread(static_cast<uchar>(c), table[c]);
+    return table;
+}
+
+
+/**
+ * Builds a table of the characters encoded by each combination of folded channel bits
+ * @param gather Gets the character for a byte of folded channel bits
+ * @return The table, indexed by the folded channel bits
+ */
+template<typename Gather>
+constexpr std::array<uchar, 256> makeGatherTable(Gather gather) {
+    std::array<uchar, 256> table{};
+    for (int f = 0; f < 256; f++) table[f] = gather(static_cast<uchar>(f));
+    return table;
+}
+
+
+// Add each quartet of bits in reverse order like [3210][7654]
+static constexpr auto spread1 = makeSpreadTable<8>([](const uchar c, std::array<uchar, 8>& channels) {
+    for (int k = 0; k < 4; k++) {
+        channels[k] = (c >> (k + 4)) & 1;
+        channels[k + 4] = (c >> k) & 1;
+    }
+});
+
+// Add each pair of bits in reverse order like [67452301]
+static constexpr auto spread2 = makeSpreadTable<4>([](const uchar c, std::array<uchar, 4>& channels) {
+    for (int k = 0; k < 4; k++)
+        channels[k] = (c >> (k * 2)) & 3;
+});
+
+// Add the last 4 bits in the first channel and the first 4 bits in the second, each in reverse order
+static constexpr auto spread4 = makeSpreadTable<2>([](const uchar c, std::array<uchar, 2>& channels) {
+    channels[0] = reversedNibbles[c >> 4];
+    channels[1] = reversedNibbles[c & 0xF];
+});
+
+// The low bit of each of the 8 channels, in channel order, holds the last 4 bits of the character then the first 4
+static constexpr auto gather1 = makeGatherTable([](const uchar f) {
+    return static_cast<uchar>(f >> 4 | (f & 0xF) << 4);
+});
+
+// The low 4 bits of the 2 channels, in channel order, hold the last and first 4 bits of the character reversed
+static constexpr auto gather4 = makeGatherTable([](const uchar f) {
+    return static_cast<uchar>(reversedNibbles[f & 0xF] << 4 | reversedNibbles[f >> 4]);
+});
+
+
+/**
+ * Loads channels as a little-endian integer so that the first channel is always in the lowest byte
+ * @tparam Word The integer type to load
+ * @param channels The channels to load
+ * @return The loaded channels
+ */
+template<typename Word>
+static Word loadLittleEndian(const uchar* channels) {
+    Word word = 0;
+    for (size_t i = 0; i < sizeof(Word); i++) word |= static_cast<Word>(channels[i]) << (i * 8);
+    return word;  // Compilers reduce this to a single load on little-endian targets
+}
+
+
+/**
+ * ORs a character's channel values from a spread table into the channels with a single word-sized operation
+ * @tparam Word An integer type the size of the table entries
+ * @param channels The channels to embed into
+ * @param spread The channel values to embed
+ */
+template<typename Word>
+static void orSpread(uchar* channels, const uchar* spread) {
+    Word word, bits;
+    memcpy(&word, channels, sizeof(Word));
+    memcpy(&bits, spread, sizeof(Word));  // Both are copied byte for byte, so the OR does not depend on byte order
+    word |= bits;
+    memcpy(channels, &word, sizeof(Word));
+}
+
+
+// Scalar kernels
+
+static void groundScalar(uchar* channels, const size_t length, const uchar mask) {
+    for (size_t i = 0; i < length; i++)
+        channels[i] &= mask;
+}
+
+static void embed1Scalar(uchar* channels, const char* chars, const size_t count) {
+    for (size_t i = 0; i < count; i++, channels += 8)
+        orSpread<uint64_t>(channels, spread1[static_cast<uchar>(chars[i])].data());
+}
+
+static void embed2Scalar(uchar* channels, const char* chars, const size_t count) {
+    for (size_t i = 0; i < count; i++, channels += 4)
+        orSpread<uint32_t>(channels, spread2[static_cast<uchar>(chars[i])].data());
+}
+
+static void embed4Scalar(uchar* channels, const char* chars, const size_t count) {
+    for (size_t i = 0; i < count; i++, channels += 2)
+        orSpread<uint16_t>(channels, spread4[static_cast<uchar>(chars[i])].data());
+}
+
+static void extract1Scalar(const uchar* channels, char* chars, const size_t count) {
+    for (size_t i = 0; i < count; i++, channels += 8) {
+        // Fold the low bit of each channel into one byte, the multiplication moves the bit of channel k to bit 56 + k
+        const uint64_t bits = loadLittleEndian<uint64_t>(channels) & 0x0101010101010101;
+        chars[i] = static_cast<char>(gather1[bits * 0x0102040810204080 >> 56]);
+    }
+}
+
+static void extract2Scalar(const uchar* channels, char* chars, const size_t count) {
+    for (size_t i = 0; i < count; i++, channels += 4) {
+        // Fold the low 2 bits of each channel into one byte, which is already the character since the 2-bit layout
+        // stores the pairs of bits in order.  The multiplication moves the bits of channel k to bit 24 + 2k
+        const uint32_t bits = loadLittleEndian<uint32_t>(channels) & 0x03030303;
+        chars[i] = static_cast<char>(bits * 0x01041040 >> 24);
+    }
+}
+
+static void extract4Scalar(const uchar* channels, char* chars, const size_t count) {
+    for (size_t i = 0; i < count; i++, channels += 2)
+        chars[i] = static_cast<char>(gather4[(channels[0] & 0xF) | (channels[1] & 0xF) << 4]);
+}
+
+static constexpr EmbedKernels scalarKernels = {
+    "scalar", groundScalar,
+    embed1Scalar, embed2Scalar, embed4Scalar,
+    extract1Scalar, extract2Scalar, extract4Scalar
+};
+
+
+// Generic kernels
+
+/**
+ * Gets the channel values that encode a character with the 1, 2, or 4-bit layout
+ * @tparam BitWidth The number of bits used for encoding within each channel
+ * @param c The character to encode
+ * @return The channel values from the spread table
+ */
+template<int BitWidth>
+static const uchar* spreadOf(const char c) {
+    if constexpr (BitWidth == 1) return spread1[static_cast<uchar>(c)].data();
+    else if constexpr (BitWidth == 2) return spread2[static_cast<uchar>(c)].data();
+    else return spread4[static_cast<uchar>(c)].data();
+}
+
+template<typename Channel>
+void groundGeneric(Channel* channels, const size_t length, const Channel mask) {
+    for (size_t i = 0; i < length; i++)
+        channels[i] &= mask;
+}
+
+template<int BitWidth, typename Channel>
+void embedGeneric(Channel* channels, const char* chars, const size_t count) {
+    constexpr int groupChars = std::lcm(8, BitWidth) / 8;
+    constexpr int groupChannels = std::lcm(8, BitWidth) / BitWidth;
+    constexpr uint32_t mask = (1u << BitWidth) - 1;
+
+    for (size_t i = 0; i < count; i += groupChars, chars += groupChars, channels += groupChannels) {
+        if constexpr (BitWidth == 1 || BitWidth == 2 || BitWidth == 4) {
+            const uchar* spread = spreadOf<BitWidth>(*chars);
+            for (int k = 0; k < groupChannels; k++) channels[k] |= spread[k];
+        } else {
+            uint32_t bits = 0;
+            for (int j = 0; j < groupChars; j++) bits |= static_cast<uint32_t>(static_cast<uchar>(chars[j])) << (j * 8);
+            for (int k = 0; k < groupChannels; k++) channels[k] |= static_cast<Channel>(bits >> (k * BitWidth) & mask);
+        }
+    }
+}
+
+template<int BitWidth, typename Channel>
+void extractGeneric(const Channel* channels, char* chars, const size_t count) {
+    constexpr int groupChars = std::lcm(8, BitWidth) / 8;
+    constexpr int groupChannels = std::lcm(8, BitWidth) / BitWidth;
+    constexpr uint32_t mask = (1u << BitWidth) - 1;
+
+    for (size_t i = 0; i < count; i += groupChars, chars += groupChars, channels += groupChannels) {
+        uint32_t bits = 0;
+        for (int k = 0; k < groupChannels; k++) bits |= (static_cast<uint32_t>(channels[k]) & mask) << (k * BitWidth);
+
+        // The 1 and 4-bit layouts store their bits out of order, so the folded bits are looked up
+        if constexpr (BitWidth == 1) *chars = static_cast<char>(gather1[bits]);
+        else if constexpr (BitWidth == 4) *chars = static_cast<char>(gather4[bits]);
+        else for (int j = 0; j < groupChars; j++) chars[j] = static_cast<char>(bits >> (j * 8));
+    }
+}
+
+template void groundGeneric<uchar>(uchar*, size_t, uchar);
+template void groundGeneric<ushort>(ushort*, size_t, ushort);
+
+/**
+ * Instantiates the generic kernels for a bit width with every channel type
+ */
+#define ICRYPT_GENERIC_KERNELS(bitWidth) \
+    template void embedGeneric<bitWidth, uchar>(uchar*, const char*, size_t); \
+    template void embedGeneric<bitWidth, ushort>(ushort*, const char*, size_t); \
+    template void extractGeneric<bitWidth, uchar>(const uchar*, char*, size_t); \
+    template void extractGeneric<bitWidth, ushort>(const ushort*, char*, size_t);
+
+ICRYPT_GENERIC_KERNELS(1)
+ICRYPT_GENERIC_KERNELS(2)
+ICRYPT_GENERIC_KERNELS(3)
+ICRYPT_GENERIC_KERNELS(4)
+ICRYPT_GENERIC_KERNELS(6)
+ICRYPT_GENERIC_KERNELS(8)
+
+
+#ifdef ICRYPT_X86_KERNELS
+
+// SSE4.1 kernels, processing 16 channels per instruction
+
+#define ICRYPT_SSE41 __attribute__((target("sse4.1")))
+
+ICRYPT_SSE41 static void groundSse41(uchar* channels, const size_t length, const uchar mask) {
+    const __m128i vMask = _mm_set1_epi8(static_cast<char>(mask));
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(channels + i), _mm_and_si128(v, vMask));
+    }
+    groundScalar(channels + i, length - i, mask);
+}
+
+/**
+ * ORs a vector of channel values into the channels at the given address
+ */
+ICRYPT_SSE41 static void orInto(uchar* channels, const __m128i v) {
+    __m128i* dst = reinterpret_cast<__m128i*>(channels);
+    _mm_storeu_si128(dst, _mm_or_si128(_mm_loadu_si128(dst), v));
+}
+
+ICRYPT_SSE41 static void embed1Sse41(uchar* channels, const char* chars, const size_t count) {
+    // Each pair of characters is broadcast across 8 channels each, then each channel keeps the bit it carries
+    const __m128i bits = _mm_setr_epi8(16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8);
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 128) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        for (int k = 0; k < 8; k++) {
+            const __m128i index = _mm_or_si128(_mm_set1_epi8(static_cast<char>(k * 2)),
+                                               _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1));
+            const __m128i spread = _mm_min_epu8(_mm_and_si128(_mm_shuffle_epi8(v, index), bits), one);
+            orInto(channels + k * 16, spread);
+        }
+    }
+    embed1Scalar(channels, chars + i, count - i);
+}
+
+ICRYPT_SSE41 static void embed2Sse41(uchar* channels, const char* chars, const size_t count) {
+    const __m128i pairMask = _mm_set1_epi8(3);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 64) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        // Split each character into its four bit pairs, then interleave them into channel order
+        const __m128i pair0 = _mm_and_si128(v, pairMask);
+        const __m128i pair1 = _mm_and_si128(_mm_srli_epi16(v, 2), pairMask);
+        const __m128i pair2 = _mm_and_si128(_mm_srli_epi16(v, 4), pairMask);
+        const __m128i pair3 = _mm_and_si128(_mm_srli_epi16(v, 6), pairMask);
+        const __m128i low01 = _mm_unpacklo_epi8(pair0, pair1), high01 = _mm_unpackhi_epi8(pair0, pair1);
+        const __m128i low23 = _mm_unpacklo_epi8(pair2, pair3), high23 = _mm_unpackhi_epi8(pair2, pair3);
+        orInto(channels, _mm_unpacklo_epi16(low01, low23));
+        orInto(channels + 16, _mm_unpackhi_epi16(low01, low23));
+        orInto(channels + 32, _mm_unpacklo_epi16(high01, high23));
+        orInto(channels + 48, _mm_unpackhi_epi16(high01, high23));
+    }
+    embed2Scalar(channels, chars + i, count - i);
+}
+
+ICRYPT_SSE41 static void embed4Sse41(uchar* channels, const char* chars, const size_t count) {
+    const __m128i reverse = _mm_load_si128(reinterpret_cast<const __m128i*>(reversedNibbles));
+    const __m128i nibbleMask = _mm_set1_epi8(0xF);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 32) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        const __m128i low = _mm_shuffle_epi8(reverse, _mm_and_si128(v, nibbleMask));
+        const __m128i high = _mm_shuffle_epi8(reverse, _mm_and_si128(_mm_srli_epi16(v, 4), nibbleMask));
+        orInto(channels, _mm_unpacklo_epi8(high, low));
+        orInto(channels + 16, _mm_unpackhi_epi8(high, low));
+    }
+    embed4Scalar(channels, chars + i, count - i);
+}
+
+ICRYPT_SSE41 static void extract1Sse41(const uchar* channels, char* chars, const size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2, channels += 16) {
+        // Move the low bit of each channel to the top of its byte and gather the bits into a mask
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels));
+        const unsigned mask = _mm_movemask_epi8(_mm_slli_epi16(v, 7));
+        // The first channel of each character holds its last 4 bits, so swap the halves of each byte
+        const unsigned swapped = (mask & 0x0F0F) << 4 | (mask >> 4 & 0x0F0F);
+        chars[i] = static_cast<char>(swapped);
+        chars[i + 1] = static_cast<char>(swapped >> 8);
+    }
+    extract1Scalar(channels, chars + i, count - i);
+}
+
+ICRYPT_SSE41 static void extract2Sse41(const uchar* channels, char* chars, const size_t count) {
+    const __m128i pairMask = _mm_set1_epi8(3);
+    const __m128i pairWeights = _mm_setr_epi8(1, 4, 1, 4, 1, 4, 1, 4, 1, 4, 1, 4, 1, 4, 1, 4);
+    const __m128i quartetWeights = _mm_setr_epi16(1, 16, 1, 16, 1, 16, 1, 16);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 64) {
+        __m128i words[4];
+        for (int k = 0; k < 4; k++) {
+            // Combine the bit pairs of neighbouring channels, then the quartets of neighbouring channel pairs
+            const __m128i v = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(channels + k * 16)), pairMask);
+            words[k] = _mm_madd_epi16(_mm_maddubs_epi16(v, pairWeights), quartetWeights);
+        }
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(words[0], words[1]), _mm_packs_epi32(words[2], words[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(chars + i), packed);
+    }
+    extract2Scalar(channels, chars + i, count - i);
+}
+
+ICRYPT_SSE41 static void extract4Sse41(const uchar* channels, char* chars, const size_t count) {
+    const __m128i reverse = _mm_load_si128(reinterpret_cast<const __m128i*>(reversedNibbles));
+    const __m128i nibbleMask = _mm_set1_epi8(0xF);
+    const __m128i nibbleWeights = _mm_setr_epi8(16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 32) {
+        const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels));
+        const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels + 16));
+        // Reverse each nibble, then combine the two nibbles of each character
+        const __m128i chars0 = _mm_maddubs_epi16(_mm_shuffle_epi8(reverse, _mm_and_si128(v0, nibbleMask)), nibbleWeights);
+        const __m128i chars1 = _mm_maddubs_epi16(_mm_shuffle_epi8(reverse, _mm_and_si128(v1, nibbleMask)), nibbleWeights);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(chars + i), _mm_packus_epi16(chars0, chars1));
+    }
+    extract4Scalar(channels, chars + i, count - i);
+}
+
+static constexpr EmbedKernels sse41Kernels = {
+    "sse4.1", groundSse41,
+    embed1Sse41, embed2Sse41, embed4Sse41,
+    extract1Sse41, extract2Sse41, extract4Sse41
+};
+
+
+// AVX2 kernels, processing 32 channels per instruction
+
+#define ICRYPT_AVX2 __attribute__((target("avx2")))
+
+ICRYPT_AVX2 static void groundAvx2(uchar* channels, const size_t length, const uchar mask) {
+    const __m256i vMask = _mm256_set1_epi8(static_cast<char>(mask));
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(channels + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(channels + i), _mm256_and_si256(v, vMask));
+    }
+    groundScalar(channels + i, length - i, mask);
+}
+
+/**
+ * ORs a vector of channel values into the channels at the given address
+ */
+ICRYPT_AVX2 static void orInto(uchar* channels, const __m256i v) {
+    __m256i* dst = reinterpret_cast<__m256i*>(channels);
+    _mm256_storeu_si256(dst, _mm256_or_si256(_mm256_loadu_si256(dst), v));
+}
+
+ICRYPT_AVX2 static void embed1Avx2(uchar* channels, const char* chars, const size_t count) {
+    const __m256i bits = _mm256_setr_epi8(16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8,
+                                          16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8);
+    const __m256i one = _mm256_set1_epi8(1);
+    // Each 128-bit lane holds the same characters, the first lane spreads characters 4k and 4k+1, the second 4k+2 and 4k+3
+    const __m256i laneOffsets = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 128) {
+        const __m256i v = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i)));
+        for (int k = 0; k < 4; k++) {
+            const __m256i index = _mm256_add_epi8(_mm256_set1_epi8(static_cast<char>(k * 4)), laneOffsets);
+            const __m256i spread = _mm256_min_epu8(_mm256_and_si256(_mm256_shuffle_epi8(v, index), bits), one);
+            orInto(channels + k * 32, spread);
+        }
+    }
+    embed1Sse41(channels, chars + i, count - i);
+}
+
+ICRYPT_AVX2 static void embed2Avx2(uchar* channels, const char* chars, const size_t count) {
+    const __m256i pairMask = _mm256_set1_epi8(3);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32, channels += 128) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars + i));
+        const __m256i pair0 = _mm256_and_si256(v, pairMask);
+        const __m256i pair1 = _mm256_and_si256(_mm256_srli_epi16(v, 2), pairMask);
+        const __m256i pair2 = _mm256_and_si256(_mm256_srli_epi16(v, 4), pairMask);
+        const __m256i pair3 = _mm256_and_si256(_mm256_srli_epi16(v, 6), pairMask);
+        const __m256i low01 = _mm256_unpacklo_epi8(pair0, pair1), high01 = _mm256_unpackhi_epi8(pair0, pair1);
+        const __m256i low23 = _mm256_unpacklo_epi8(pair2, pair3), high23 = _mm256_unpackhi_epi8(pair2, pair3);
+        // The unpacks work within 128-bit lanes, so each result holds characters from both halves of the input
+        const __m256i chars0 = _mm256_unpacklo_epi16(low01, low23);   // Characters 0-3 and 16-19
+        const __m256i chars4 = _mm256_unpackhi_epi16(low01, low23);   // Characters 4-7 and 20-23
+        const __m256i chars8 = _mm256_unpacklo_epi16(high01, high23); // Characters 8-11 and 24-27
+        const __m256i chars12 = _mm256_unpackhi_epi16(high01, high23);// Characters 12-15 and 28-31
+        orInto(channels, _mm256_permute2x128_si256(chars0, chars4, 0x20));
+        orInto(channels + 32, _mm256_permute2x128_si256(chars8, chars12, 0x20));
+        orInto(channels + 64, _mm256_permute2x128_si256(chars0, chars4, 0x31));
+        orInto(channels + 96, _mm256_permute2x128_si256(chars8, chars12, 0x31));
+    }
+    embed2Sse41(channels, chars + i, count - i);
+}
+
+ICRYPT_AVX2 static void embed4Avx2(uchar* channels, const char* chars, const size_t count) {
+    const __m256i reverse = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(reversedNibbles)));
+    const __m256i nibbleMask = _mm256_set1_epi8(0xF);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32, channels += 64) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars + i));
+        const __m256i low = _mm256_shuffle_epi8(reverse, _mm256_and_si256(v, nibbleMask));
+        const __m256i high = _mm256_shuffle_epi8(reverse, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibbleMask));
+        const __m256i chars0 = _mm256_unpacklo_epi8(high, low);  // Characters 0-7 and 16-23
+        const __m256i chars8 = _mm256_unpackhi_epi8(high, low);  // Characters 8-15 and 24-31
+        orInto(channels, _mm256_permute2x128_si256(chars0, chars8, 0x20));
+        orInto(channels + 32, _mm256_permute2x128_si256(chars0, chars8, 0x31));
+    }
+    embed4Sse41(channels, chars + i, count - i);
+}
+
+ICRYPT_AVX2 static void extract1Avx2(const uchar* channels, char* chars, const size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, channels += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(channels));
+        const uint32_t mask = _mm256_movemask_epi8(_mm256_slli_epi16(v, 7));
+        const uint32_t swapped = (mask & 0x0F0F0F0F) << 4 | (mask >> 4 & 0x0F0F0F0F);
+        memcpy(chars + i, &swapped, 4);  // Little-endian, so the first character is in the lowest byte
+    }
+    extract1Sse41(channels, chars + i, count - i);
+}
+
+ICRYPT_AVX2 static void extract2Avx2(const uchar* channels, char* chars, const size_t count) {
+    const __m256i pairMask = _mm256_set1_epi8(3);
+    const __m256i pairWeights = _mm256_set1_epi16(4 << 8 | 1);
+    const __m256i quartetWeights = _mm256_set1_epi32(16 << 16 | 1);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32, channels += 128) {
+        __m256i words[4];
+        for (int k = 0; k < 4; k++) {
+            const __m256i v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(channels + k * 32)), pairMask);
+            words[k] = _mm256_madd_epi16(_mm256_maddubs_epi16(v, pairWeights), quartetWeights);
+        }
+        // The packs work within 128-bit lanes, so restore the order of each group of 4 characters afterwards
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(words[0], words[1]), _mm256_packs_epi32(words[2], words[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(chars + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    extract2Sse41(channels, chars + i, count - i);
+}
+
+ICRYPT_AVX2 static void extract4Avx2(const uchar* channels, char* chars, const size_t count) {
+    const __m256i reverse = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(reversedNibbles)));
+    const __m256i nibbleMask = _mm256_set1_epi8(0xF);
+    const __m256i nibbleWeights = _mm256_set1_epi16(1 << 8 | 16);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32, channels += 64) {
+        const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(channels));
+        const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(channels + 32));
+        const __m256i chars0 = _mm256_maddubs_epi16(_mm256_shuffle_epi8(reverse, _mm256_and_si256(v0, nibbleMask)), nibbleWeights);
+        const __m256i chars1 = _mm256_maddubs_epi16(_mm256_shuffle_epi8(reverse, _mm256_and_si256(v1, nibbleMask)), nibbleWeights);
+        const __m256i packed = _mm256_packus_epi16(chars0, chars1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(chars + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    extract4Sse41(channels, chars + i, count - i);
+}
+
+static constexpr EmbedKernels avx2Kernels = {
+    "avx2", groundAvx2,
+    embed1Avx2, embed2Avx2, embed4Avx2,
+    extract1Avx2, extract2Avx2, extract4Avx2
+};
+
+#endif
+
+
+#ifdef ICRYPT_NEON_KERNELS
+
+// NEON kernels, processing 16 channels per instruction and using interleaved loads to separate the channels of each
+// character
+
+static void groundNeon(uchar* channels, const size_t length, const uchar mask) {
+    const uint8x16_t vMask = vdupq_n_u8(mask);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+        vst1q_u8(channels + i, vandq_u8(vld1q_u8(channels + i), vMask));
+    groundScalar(channels + i, length - i, mask);
+}
+
+static void embed1Neon(uchar* channels, const char* chars, const size_t count) {
+    const uint8x16_t one = vdupq_n_u8(1);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8, channels += 64) {
+        // Each pair of pixels holds the last 4 bits of its character followed by the first 4 bits
+        const uint8x8_t v = vld1_u8(reinterpret_cast<const uint8_t*>(chars + i));
+        const uint8x8x2_t halves = vzip_u8(vshr_n_u8(v, 4), vand_u8(v, vdup_n_u8(0xF)));
+        const uint8x16_t nibbles = vcombine_u8(halves.val[0], halves.val[1]);
+        uint8x16x4_t pixels = vld4q_u8(channels);
+        pixels.val[0] = vorrq_u8(pixels.val[0], vandq_u8(nibbles, one));
+        pixels.val[1] = vorrq_u8(pixels.val[1], vandq_u8(vshrq_n_u8(nibbles, 1), one));
+        pixels.val[2] = vorrq_u8(pixels.val[2], vandq_u8(vshrq_n_u8(nibbles, 2), one));
+        pixels.val[3] = vorrq_u8(pixels.val[3], vshrq_n_u8(nibbles, 3));
+        vst4q_u8(channels, pixels);
+    }
+    embed1Scalar(channels, chars + i, count - i);
+}
+
+static void embed2Neon(uchar* channels, const char* chars, const size_t count) {
+    const uint8x16_t pairMask = vdupq_n_u8(3);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 64) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(chars + i));
+        uint8x16x4_t pixels = vld4q_u8(channels);
+        pixels.val[0] = vorrq_u8(pixels.val[0], vandq_u8(v, pairMask));
+        pixels.val[1] = vorrq_u8(pixels.val[1], vandq_u8(vshrq_n_u8(v, 2), pairMask));
+        pixels.val[2] = vorrq_u8(pixels.val[2], vandq_u8(vshrq_n_u8(v, 4), pairMask));
+        pixels.val[3] = vorrq_u8(pixels.val[3], vshrq_n_u8(v, 6));
+        vst4q_u8(channels, pixels);
+    }
+    embed2Scalar(channels, chars + i, count - i);
+}
+
+static void embed4Neon(uchar* channels, const char* chars, const size_t count) {
+    const uint8x16_t reverse = vld1q_u8(reversedNibbles);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 32) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(chars + i));
+        uint8x16x2_t pairs = vld2q_u8(channels);
+        pairs.val[0] = vorrq_u8(pairs.val[0], vqtbl1q_u8(reverse, vshrq_n_u8(v, 4)));
+        pairs.val[1] = vorrq_u8(pairs.val[1], vqtbl1q_u8(reverse, vandq_u8(v, vdupq_n_u8(0xF))));
+        vst2q_u8(channels, pairs);
+    }
+    embed4Scalar(channels, chars + i, count - i);
+}
+
+static void extract1Neon(const uchar* channels, char* chars, const size_t count) {
+    const uint8x16_t one = vdupq_n_u8(1);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8, channels += 64) {
+        const uint8x16x4_t pixels = vld4q_u8(channels);
+        uint8x16_t nibbles = vandq_u8(pixels.val[0], one);
+        nibbles = vorrq_u8(nibbles, vshlq_n_u8(vandq_u8(pixels.val[1], one), 1));
+        nibbles = vorrq_u8(nibbles, vshlq_n_u8(vandq_u8(pixels.val[2], one), 2));
+        nibbles = vorrq_u8(nibbles, vshlq_n_u8(vandq_u8(pixels.val[3], one), 3));
+        // Even pixels hold the last 4 bits of each character, odd pixels the first 4 bits
+        const uint8x16x2_t halves = vuzpq_u8(nibbles, nibbles);
+        const uint8x8_t v = vorr_u8(vshl_n_u8(vget_low_u8(halves.val[0]), 4), vget_low_u8(halves.val[1]));
+        vst1_u8(reinterpret_cast<uint8_t*>(chars + i), v);
+    }
+    extract1Scalar(channels, chars + i, count - i);
+}
+
+static void extract2Neon(const uchar* channels, char* chars, const size_t count) {
+    const uint8x16_t pairMask = vdupq_n_u8(3);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 64) {
+        const uint8x16x4_t pixels = vld4q_u8(channels);
+        uint8x16_t v = vandq_u8(pixels.val[0], pairMask);
+        v = vorrq_u8(v, vshlq_n_u8(vandq_u8(pixels.val[1], pairMask), 2));
+        v = vorrq_u8(v, vshlq_n_u8(vandq_u8(pixels.val[2], pairMask), 4));
+        v = vorrq_u8(v, vshlq_n_u8(pixels.val[3], 6));
+        vst1q_u8(reinterpret_cast<uint8_t*>(chars + i), v);
+    }
+    extract2Scalar(channels, chars + i, count - i);
+}
+
+static void extract4Neon(const uchar* channels, char* chars, const size_t count) {
+    const uint8x16_t reverse = vld1q_u8(reversedNibbles);
+    const uint8x16_t nibbleMask = vdupq_n_u8(0xF);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, channels += 32) {
+        const uint8x16x2_t pairs = vld2q_u8(channels);
+        const uint8x16_t high = vqtbl1q_u8(reverse, vandq_u8(pairs.val[0], nibbleMask));
+        const uint8x16_t low = vqtbl1q_u8(reverse, vandq_u8(pairs.val[1], nibbleMask));
+        vst1q_u8(reinterpret_cast<uint8_t*>(chars + i), vorrq_u8(vshlq_n_u8(high, 4), low));
+    }
+    extract4Scalar(channels, chars + i, count - i);
+}
+
+static constexpr EmbedKernels neonKernels = {
+    "neon", groundNeon,
+    embed1Neon, embed2Neon, embed4Neon,
+    extract1Neon, extract2Neon, extract4Neon
+};
+
+#endif
+
+
+std::vector<const EmbedKernels*> availableEmbedKernels() {
+
+    std::vector<const EmbedKernels*> kernels = {&scalarKernels};
+#ifdef ICRYPT_X86_KERNELS
+    if (cv::checkHardwareSupport(CV_CPU_SSE4_1)) kernels.push_back(&sse41Kernels);
+    if (cv::checkHardwareSupport(CV_CPU_AVX2)) kernels.push_back(&avx2Kernels);
+#endif
+#ifdef ICRYPT_NEON_KERNELS
+    kernels.push_back(&neonKernels);  // NEON is always available on AArch64
+#endif
+    return kernels;
+}
+
+
+const EmbedKernels& embedKernels() {
+    // The kernels are ordered from slowest to fastest
+    static const EmbedKernels& selected = *availableEmbedKernels().back();
+    return selected;
+}
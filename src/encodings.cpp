@@ -3,82 +3,750 @@
 //
 
 
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <opencv2/core/utility.hpp>
 
+#include "aes_ctr.h"
 #include "encodings.h"
+#include "sha256.h"
+#include "keystream_cache.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ICRYPT_X86_KERNELS
+#include <immintrin.h>
+#endif
 
-Encoding* encodingFromName(const std::string& name) {
-    Encoding* encodings[] = {new PlainEncoding(), new ShiftAllEncoding(), new ShiftCharEncoding()};
+
+/**
+ * The number of characters that shifted text wraps around within
+ */
+static constexpr int charMax = 128;
+
+
+/**
+ * Hashes a key into the amount that shiftall shifts every character by
+ * @param key The key to hash
+ * @return The shift, from 0 to charMax - 1
+ */
+static int keyHashOf(const std::string& key) {
+    return abs(static_cast<int>(std::hash<std::string>{}(key)) % charMax);
+}
+
+
+/**
+ * Shifts characters in place, up or down by a single amount
+ */
+typedef void (*ShiftKernel)(char* text, size_t length, int keyHash);
+
+
+/**
+ * Shifts characters in place, up or down by a separate amount for each character
+ */
+typedef void (*ShiftEachKernel)(char* text, const uint8_t* shifts, size_t length);
+
+
+/**
+ * A set of kernels that shift text within the 7-bit range
+ */
+struct ShiftKernels {
+    ShiftKernel up;
+    ShiftKernel down;
+    ShiftEachKernel upEach;
+    ShiftEachKernel downEach;
+};
+
+
+// Scalar kernels, which define the exact shifts that every other kernel must match
+
+static char shiftUp(const int chr, const int keyHash) {
+    return static_cast<char>(chr + keyHash < charMax ? chr + keyHash : chr + keyHash - charMax);
+}
+
+static char shiftDown(const int chr, const int keyHash) {
+    return static_cast<char>(chr - keyHash > 0 ? chr - keyHash : chr - keyHash + charMax);
+}
+
+static void shiftUpScalar(char* text, const size_t length, const int keyHash) {
+    for (size_t i = 0; i < length; i++) text[i] = shiftUp(text[i], keyHash);
+}
+
+static void shiftDownScalar(char* text, const size_t length, const int keyHash) {
+    for (size_t i = 0; i < length; i++) text[i] = shiftDown(text[i], keyHash);
+}
+
+static void shiftUpEachScalar(char* text, const uint8_t* shifts, const size_t length) {
+    for (size_t i = 0; i < length; i++) text[i] = shiftUp(text[i], shifts[i]);
+}
+
+static void shiftDownEachScalar(char* text, const uint8_t* shifts, const size_t length) {
+    for (size_t i = 0; i < length; i++) text[i] = shiftDown(text[i], shifts[i]);
+}
+
+
+#ifdef ICRYPT_X86_KERNELS
+
+// AVX2 kernels.  Wrapping by charMax only flips the top bit of a byte, so the wraparound becomes a compare and an xor
+
+#define ICRYPT_AVX2 __attribute__((target("avx2")))
+
+ICRYPT_AVX2 static __m256i shiftUpAvx2(const __m256i chars, const __m256i shift) {
+    const __m256i limit = _mm256_sub_epi8(_mm256_set1_epi8(charMax - 1), shift);
+    const __m256i wrapped = _mm256_and_si256(_mm256_cmpgt_epi8(chars, limit), _mm256_set1_epi8(static_cast<char>(charMax)));
+    return _mm256_xor_si256(_mm256_add_epi8(chars, shift), wrapped);
+}
+
+ICRYPT_AVX2 static __m256i shiftDownAvx2(const __m256i chars, const __m256i shift) {
+    const __m256i wrapped = _mm256_andnot_si256(_mm256_cmpgt_epi8(chars, shift), _mm256_set1_epi8(static_cast<char>(charMax)));
+    return _mm256_xor_si256(_mm256_sub_epi8(chars, shift), wrapped);
+}
+
+ICRYPT_AVX2 static void shiftUpAvx2(char* text, const size_t length, const int keyHash) {
+    const __m256i shift = _mm256_set1_epi8(static_cast<char>(keyHash));
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(text + i), shiftUpAvx2(chars, shift));
+    }
+    shiftUpScalar(text + i, length - i, keyHash);
+}
+
+ICRYPT_AVX2 static void shiftDownAvx2(char* text, const size_t length, const int keyHash) {
+    const __m256i shift = _mm256_set1_epi8(static_cast<char>(keyHash));
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(text + i), shiftDownAvx2(chars, shift));
+    }
+    shiftDownScalar(text + i, length - i, keyHash);
+}
+
+ICRYPT_AVX2 static void shiftUpEachAvx2(char* text, const uint8_t* shifts, const size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        const __m256i shift = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(shifts + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(text + i), shiftUpAvx2(chars, shift));
+    }
+    shiftUpEachScalar(text + i, shifts + i, length - i);
+}
+
+ICRYPT_AVX2 static void shiftDownEachAvx2(char* text, const uint8_t* shifts, const size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        const __m256i shift = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(shifts + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(text + i), shiftDownAvx2(chars, shift));
+    }
+    shiftDownEachScalar(text + i, shifts + i, length - i);
+}
+
+#endif
+
+
+/**
+ * Selects the fastest shift kernels supported by the current CPU.  The CPU is only checked on the first call
+ * @return The shift kernels
+ */
+static const ShiftKernels& shiftKernels() {
+    static const ShiftKernels kernels = [] {
+#ifdef ICRYPT_X86_KERNELS
+        if (cv::checkHardwareSupport(CV_CPU_AVX2))
+            return ShiftKernels{shiftUpAvx2, shiftDownAvx2, shiftUpEachAvx2, shiftDownEachAvx2};
+#endif
+        return ShiftKernels{shiftUpScalar, shiftDownScalar, shiftUpEachScalar, shiftDownEachScalar};
+    }();
+    return kernels;
+}
+
+
+/**
+ * The number of shifts that a keystream generates at a time, which is small enough to stay on the stack
+ */
+static constexpr size_t keystreamBlock = 4096;
+
+
+/**
+ * Generates the shiftchar shift of each character, which is the shiftall shift for the key character at its index
+ * followed by the decimal index.  The index and the position in the key are counted up in place, so no strings are
+ * built and no remainders are taken for any character
+ */
+class Keystream {
+
+public:
+
+    /**
+     * Starts a keystream at the given character index
+     * @param key The key to generate shifts from
+     * @param index The index of the first character to generate a shift for
+     */
+    Keystream(const std::string& key, const size_t index)
+        : key(key), index(index), keyIndex(key.empty() ? 0 : index % key.length()),
+          firstDigit(charKey + (key.empty() ? 0 : 1)), digitsEnd(std::to_chars(firstDigit, std::end(charKey), index).ptr) {}
+
+    /**
+     * Generates the shifts of the next characters
+     * @param shifts The buffer to write the shifts to
+     * @param count The number of shifts to generate
+     */
+    void next(uint8_t* shifts, const size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (!key.empty()) charKey[0] = key[keyIndex];
+            const size_t hash = std::hash<std::string_view>{}(std::string_view(charKey, digitsEnd - charKey));
+            shifts[i] = static_cast<uint8_t>(abs(static_cast<int>(hash) % charMax));
+            increment();
+        }
+    }
+
+private:
+
+    /**
+     * Counts the index and its decimal digits up by one
+     */
+    void increment() {
+        index++;
+        if (++keyIndex == key.length()) keyIndex = 0;
+        char* digit = digitsEnd - 1;
+        for (; digit >= firstDigit && *digit == '9'; digit--) *digit = '0';
+        if (digit >= firstDigit) (*digit)++;
+        else {  // Every digit carried, so the index gained a digit
+            *firstDigit = '1';
+            *digitsEnd++ = '0';
+        }
+    }
+
+    const std::string& key;
+    size_t index;
+    size_t keyIndex;
+    char charKey[1 + std::numeric_limits<size_t>::digits10 + 1] = {};  // The key character and the decimal index
+    char* const firstDigit;
+    char* digitsEnd;
+};
+
+
+/**
+ * The fewest characters that are worth shifting on their own thread
+ */
+static constexpr size_t minChunkChars = 1 << 16;
+
+
+/**
+ * Shifts a piece of text in place by the shiftchar keystream of the key, a block of shifts at a time
+ * @param text The piece of text to shift
+ * @param length The number of characters to shift
+ * @param position The index of the first character of the piece within the whole text
+ * @param key The key to generate shifts from
+ * @param shift The kernel that applies each block of shifts
+ */
+static void shiftRange(char* text, const size_t length, const size_t position, const std::string& key,
+                       const ShiftEachKernel shift) {
+    Keystream keystream(key, position);
+    uint8_t shifts[keystreamBlock];
+    for (size_t i = 0; i < length; i += keystreamBlock) {
+        const size_t count = std::min(keystreamBlock, length - i);
+        keystream.next(shifts, count);
+        shift(text + i, shifts, count);
+    }
+}
+
+
+/**
+ * Splits a run of characters into ranges that are processed in parallel.  Runs that are too short to be worth starting
+ * threads for are processed as a single range
+ * @param length The number of characters to split
+ * @param threads The number of threads to use, or 0 to use all available threads
+ * @param process Processes the characters from a begin index to an end index
+ */
+template<typename Process>
+static void forEachChunk(const size_t length, const int threads, const Process& process) {
+    const size_t maxChunks = threads > 0 ? threads : std::max(cv::getNumThreads(), 1);
+    const size_t chunks = std::max<size_t>(std::min(maxChunks, length / minChunkChars), 1);
+    if (chunks == 1) {
+        process(0, length);
+        return;
+    }
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(chunks)), [&](const cv::Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+            process(length * chunk / chunks, length * (chunk + 1) / chunks);
+    }, static_cast<double>(chunks));
+}
+
+
+/**
+ * Shifts text in place by the shiftchar keystream of the key.  Each shift only depends on the key and the index of its
+ * character, so the text is split into ranges that are shifted in parallel.  If a keystream cache directory is set,
+ * the shifts are read from the cache instead of being generated
+ * @param text The text to shift
+ * @param length The number of characters to shift
+ * @param key The key to generate shifts from
+ * @param cacheDigest The digest of the key that its keystream is cached under
+ * @param shift The kernel that applies each block of shifts
+ * @param threads The number of threads to shift with, or 0 to use all available threads
+ */
+static void shiftByKeystream(char* text, const size_t length, const std::string& key,
+                             const std::array<uint8_t, sha256Size>& cacheDigest, const ShiftEachKernel shift,
+                             const int threads) {
+    if (!keystreamCacheDirectory().empty() && length > 0) {
+        KeystreamCache cache(keystreamCacheDirectory(), cacheDigest, [&](uint8_t* shifts, const size_t index, const size_t count) {
+            forEachChunk(count, threads, [&](const size_t begin, const size_t end) {
+                Keystream(key, index + begin).next(shifts + begin, end - begin);
+            });
+        });
+        if (const uint8_t* shifts = cache.shifts(length)) {
+            forEachChunk(length, threads, [&](const size_t begin, const size_t end) {
+                shift(text + begin, shifts + begin, end - begin);
+            });
+            return;
+        }
+    }
+
+    forEachChunk(length, threads, [&](const size_t begin, const size_t end) {
+        shiftRange(text + begin, end - begin, begin, key, shift);
+    });
+}
+
+
+/**
+ * The number of shifts that hashchar generates from each hash, one for each byte of its eight 32-bit lanes
+ */
+static constexpr size_t hashBlockSize = 32;
+
+
+/**
+ * The number of 32-bit lanes in a hashchar hash, each of which is seeded by one word of the key digest
+ */
+static constexpr size_t hashLanes = hashBlockSize / 4;
+
+
+/**
+ * Generates the hashchar shifts of whole blocks of characters
+ */
+typedef void (*HashKernel)(const uint32_t* seed, uint64_t block, size_t blocks, uint8_t* shifts);
+
+
+// Scalar hash kernel, which defines the exact shifts that every other kernel must match.  Lane j of block b is
+// mix(mix(seed[j] ^ low(b)) ^ high(b) ^ seed[(j + 4) % 8]), where mix is the lowbias32 integer hash, and its four bytes
+// are the shifts of the lane's characters from least to most significant, masked to 7 bits
+
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352D;
+    x ^= x >> 15;
+    x *= 0x846CA68B;
+    return x ^ (x >> 16);
+}
+
+static void hashScalar(const uint32_t* seed, const uint64_t block, const size_t blocks, uint8_t* shifts) {
+    for (size_t b = 0; b < blocks; b++) {
+        const uint32_t low = static_cast<uint32_t>(block + b);
+        const uint32_t high = static_cast<uint32_t>((block + b) >> 32);
+        for (size_t lane = 0; lane < hashLanes; lane++) {
+            const uint32_t hash = mix(mix(seed[lane] ^ low) ^ high ^ seed[(lane + 4) % hashLanes]);
+            for (int i = 0; i < 4; i++) *shifts++ = static_cast<uint8_t>(hash >> (i * 8) & (charMax - 1));
+        }
+    }
+}
+
+
+#ifdef ICRYPT_X86_KERNELS
+
+// AVX2 hash kernel.  Each lane of a vector is one lane of the hash, so a single vector holds a whole block of shifts
+
+ICRYPT_AVX2 static __m256i mixAvx2(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(0x7FEB352D));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(static_cast<int>(0x846CA68B)));
+    return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+ICRYPT_AVX2 static void hashAvx2(const uint32_t* seed, const uint64_t block, const size_t blocks, uint8_t* shifts) {
+    const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seed));
+    const __m256i second = _mm256_permute2x128_si256(first, first, 0x01);
+    const __m256i mask = _mm256_set1_epi8(charMax - 1);
+    for (size_t b = 0; b < blocks; b++) {
+        const __m256i low = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(block + b)));
+        const __m256i high = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>((block + b) >> 32)));
+        const __m256i hash = mixAvx2(_mm256_xor_si256(_mm256_xor_si256(mixAvx2(_mm256_xor_si256(first, low)), high), second));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(shifts + b * hashBlockSize), _mm256_and_si256(hash, mask));
+    }
+}
+
+#endif
+
+
+/**
+ * Selects the fastest hash kernel supported by the current CPU.  The CPU is only checked on the first call
+ * @return The hash kernel
+ */
+static HashKernel hashKernel() {
+    static const HashKernel kernel = [] {
+#ifdef ICRYPT_X86_KERNELS
+        if (cv::checkHardwareSupport(CV_CPU_AVX2)) return hashAvx2;
+#endif
+        return hashScalar;
+    }();
+    return kernel;
+}
+
+
+/**
+ * Shifts a piece of text in place by the hashchar keystream of a seed, a block of shifts at a time
+ * @param text The piece of text to shift
+ * @param length The number of characters to shift
+ * @param position The index of the first character of the piece within the whole text
+ * @param seed The hash lane seeds, which are the words of the key digest
+ * @param shift The kernel that applies each block of shifts
+ */
+static void hashRange(char* text, const size_t length, const size_t position, const uint32_t* seed,
+                      const ShiftEachKernel shift) {
+    const HashKernel hash = hashKernel();
+
+    // Pieces may start partway through a block, so one extra block is generated to cover the skipped shifts
+    uint8_t shifts[keystreamBlock + hashBlockSize];
+    for (size_t i = 0; i < length;) {
+        const size_t skip = (position + i) % hashBlockSize;
+        const size_t count = std::min(keystreamBlock, length - i);
+        hash(seed, (position + i) / hashBlockSize, (skip + count + hashBlockSize - 1) / hashBlockSize, shifts);
+        shift(text + i, shifts + skip, count);
+        i += count;
+    }
+}
+
+
+/**
+ * Shifts text in place by the hashchar keystream of a seed.  Each block of shifts only depends on the seed and the index
+ * of the block, so the text is split into ranges that are shifted in parallel
+ * @param text The text to shift
+ * @param length The number of characters to shift
+ * @param seed The hash lane seeds, which are the words of the key digest
+ * @param shift The kernel that applies each block of shifts
+ * @param threads The number of threads to shift with, or 0 to use all available threads
+ */
+static void shiftByHash(char* text, const size_t length, const uint32_t* seed, const ShiftEachKernel shift,
+                        const int threads) {
+    forEachChunk(length, threads, [&](const size_t begin, const size_t end) {
+        hashRange(text + begin, end - begin, begin, seed, shift);
+    });
+}
+
+
+// Byte kernels, which wrap around all 256 byte values and so vectorize without any help
+
+static void addEach(char* bytes, const uint8_t* shifts, const size_t length) {
+    for (size_t i = 0; i < length; i++) bytes[i] = static_cast<char>(static_cast<uint8_t>(bytes[i]) + shifts[i]);
+}
+
+static void subtractEach(char* bytes, const uint8_t* shifts, const size_t length) {
+    for (size_t i = 0; i < length; i++) bytes[i] = static_cast<char>(static_cast<uint8_t>(bytes[i]) - shifts[i]);
+}
+
+
+/**
+ * The key schedule of an encoding that needs no key material
+ */
+struct EmptySchedule final : KeySchedule {};
+
+
+/**
+ * The key schedule of shiftall, which shifts every character by the same amount
+ */
+struct ShiftAllSchedule final : KeySchedule {
+
+    int keyHash;
+
+    explicit ShiftAllSchedule(const int keyHash) : keyHash(keyHash) {}
+};
+
+
+/**
+ * The key schedule of shiftchar.  Each shift is the standard library hash of the key character together with the
+ * decimal index, and that hash cannot be resumed from a partial state, so nothing besides the key characters themselves
+ * can be derived ahead of the index.  The shifts are generated as they are needed, and only the digest that the
+ * keystream is cached under is computed here
+ */
+struct ShiftCharSchedule final : KeySchedule {
+
+    std::string key;
+    std::array<uint8_t, sha256Size> cacheDigest;
+
+    explicit ShiftCharSchedule(std::string key) : key(std::move(key)), cacheDigest(keystreamCacheDigest(this->key)) {}
+};
+
+
+/**
+ * The key schedule of hashchar, which seeds each lane of the hash with a word of the key digest
+ */
+struct HashCharSchedule final : KeySchedule {
+
+    uint32_t seed[hashLanes];
+
+    explicit HashCharSchedule(const std::array<uint8_t, sha256Size>& digest) {
+        for (size_t lane = 0; lane < hashLanes; lane++)
+            seed[lane] = digest[lane * 4] | digest[lane * 4 + 1] << 8 | digest[lane * 4 + 2] << 16 |
+                         static_cast<uint32_t>(digest[lane * 4 + 3]) << 24;
+    }
+};
+
+
+/**
+ * The key schedule of aesctr, which is the expanded AES key and the initial counter block
+ */
+struct AesCtrSchedule final : KeySchedule {
+
+    AesCtr aes;
+
+    explicit AesCtrSchedule(const AesCtr& aes) : aes(aes) {}
+};
+
+
+/**
+ * Gets a key schedule as the type that an encoding prepares
+ * @tparam Schedule The type of key schedule that the encoding prepares
+ * @param schedule The key schedule
+ * @return The key schedule as the given type
+ */
+template<typename Schedule>
+static const Schedule& scheduleAs(const KeySchedule& schedule) {
+    const auto* typed = dynamic_cast<const Schedule*>(&schedule);
+    if (!typed) throw std::runtime_error("Key schedule was prepared by a different encoding!");
+    return *typed;
+}
+
+
+const Encoding* encodingFromName(const std::string& name) {
+    static const PlainEncoding plain;
+    static const ShiftAllEncoding shiftAll;
+    static const ShiftCharEncoding shiftChar;
+    static const AesCtrEncoding aesCtr;
+    static const HashCharEncoding hashChar;
+    static const Encoding* const encodings[] = {&plain, &shiftAll, &shiftChar, &aesCtr, &hashChar};
     std::string availEncodings;
 
-    for (Encoding* enc : encodings) {
+    for (const Encoding* enc : encodings) {
         if (name == enc->name())
             return enc;
 
         availEncodings += enc->name() + ", ";
-        delete enc;  // Clean up the unused encoding
     }
 
     throw std::runtime_error("Encoding '" + name + "' not found!  Available encodings are: " + availEncodings);
 }
 
 
+// Encoding implementation
+std::string Encoding::decode(std::string encoded, const KeySchedule& schedule, const int threads) const {
+    decode(encoded.data(), encoded.length(), schedule, threads);
+    return encoded;
+}
+
+std::string Encoding::encode(std::string raw, const KeySchedule& schedule, const int threads) const {
+    encode(raw.data(), raw.length(), schedule, threads);
+    return raw;
+}
+
+std::string Encoding::decodeBytes(std::string encoded, const KeySchedule& schedule, const int threads) const {
+    decodeBytes(encoded.data(), encoded.length(), schedule, threads);
+    return encoded;
+}
+
+std::string Encoding::encodeBytes(std::string raw, const KeySchedule& schedule, const int threads) const {
+    encodeBytes(raw.data(), raw.length(), schedule, threads);
+    return raw;
+}
+
+std::string Encoding::decode(std::string encoded, const std::string& key, const int threads) const {
+    return decode(std::move(encoded), *prepare(key), threads);
+}
+
+std::string Encoding::encode(std::string raw, const std::string& key, const int threads) const {
+    return encode(std::move(raw), *prepare(key), threads);
+}
+
+std::string Encoding::decodeBytes(std::string encoded, const std::string& key, const int threads) const {
+    return decodeBytes(std::move(encoded), *prepare(key), threads);
+}
+
+std::string Encoding::encodeBytes(std::string raw, const std::string& key, const int threads) const {
+    return encodeBytes(std::move(raw), *prepare(key), threads);
+}
+
 // PlainEncoding implementation
-std::string PlainEncoding::name() { return "plain"; }
+std::string PlainEncoding::name() const { return "plain"; }
+
+uint8_t PlainEncoding::id() const { return 0; }
 
-std::string PlainEncoding::decode(std::string encoded, const std::string& key) { return encoded; }
+std::shared_ptr<const KeySchedule> PlainEncoding::prepare(const std::string& key, const std::string& nonce) const {
+    return std::make_shared<EmptySchedule>();
+}
 
-std::string PlainEncoding::encode(std::string raw, const std::string& key) { return raw; }
+void PlainEncoding::decode(char* text, size_t length, const KeySchedule& schedule, const int threads) const {}
+
+void PlainEncoding::encode(char* text, size_t length, const KeySchedule& schedule, const int threads) const {}
+
+void PlainEncoding::decodeBytes(char* bytes, size_t length, const KeySchedule& schedule, const int threads) const {}
+
+void PlainEncoding::encodeBytes(char* bytes, size_t length, const KeySchedule& schedule, const int threads) const {}
+
+void PlainEncoding::encodeAt(char* text, size_t length, size_t position, const KeySchedule& schedule) const {}
+
+void PlainEncoding::encodeBytesAt(char* bytes, size_t length, size_t position, const KeySchedule& schedule) const {}
 
 // ShiftAllEncoding implementation
-std::string ShiftAllEncoding::name() { return "shiftall"; }
+std::string ShiftAllEncoding::name() const { return "shiftall"; }
 
-std::string ShiftAllEncoding::decode(std::string encoded, const std::string& key) {
-    constexpr int charMax = 128;
-    std::string decoded;
-    const int keyHash = abs(static_cast<int>(std::hash<std::string>{}(key)) % charMax);
+uint8_t ShiftAllEncoding::id() const { return 1; }
 
-    for (const char chr : encoded)
-        decoded += static_cast<char>(chr - keyHash > 0 ? chr - keyHash : chr - keyHash + charMax);
+std::shared_ptr<const KeySchedule> ShiftAllEncoding::prepare(const std::string& key, const std::string& nonce) const {
+    return std::make_shared<ShiftAllSchedule>(keyHashOf(key));
+}
 
-    return decoded;
+void ShiftAllEncoding::decode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    shiftKernels().down(text, length, scheduleAs<ShiftAllSchedule>(schedule).keyHash);
 }
 
-std::string ShiftAllEncoding::encode(std::string raw, const std::string& key) {
-    constexpr int charMax = 128;
-    std::string encoded;
-    const int keyHash = abs(static_cast<int>(std::hash<std::string>{}(key)) % charMax);
+void ShiftAllEncoding::encode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    shiftKernels().up(text, length, scheduleAs<ShiftAllSchedule>(schedule).keyHash);
+}
 
-    for (const char chr : raw)
-        encoded += static_cast<char>(chr + keyHash<charMax ? chr + keyHash : chr + keyHash - charMax);
-    return encoded;
+void ShiftAllEncoding::decodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    const int keyHash = scheduleAs<ShiftAllSchedule>(schedule).keyHash;
+
+    for (size_t i = 0; i < length; i++)
+        bytes[i] = static_cast<char>(static_cast<unsigned char>(bytes[i]) - keyHash);
+}
+
+void ShiftAllEncoding::encodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    const int keyHash = scheduleAs<ShiftAllSchedule>(schedule).keyHash;
+
+    for (size_t i = 0; i < length; i++)
+        bytes[i] = static_cast<char>(static_cast<unsigned char>(bytes[i]) + keyHash);
+}
+
+void ShiftAllEncoding::encodeAt(char* text, const size_t length, size_t position, const KeySchedule& schedule) const {
+    encode(text, length, schedule);
+}
+
+void ShiftAllEncoding::encodeBytesAt(char* bytes, const size_t length, size_t position, const KeySchedule& schedule) const {
+    encodeBytes(bytes, length, schedule);
 }
 
 // ShiftCharEncoding implementation
-std::string ShiftCharEncoding::name() { return "shiftchar"; }
+std::string ShiftCharEncoding::name() const { return "shiftchar"; }
 
-std::string ShiftCharEncoding::decode(const std::string encoded, const std::string& key) {
-    std::string decoded;
-    ShiftAllEncoding subEncoder = ShiftAllEncoding();
+uint8_t ShiftCharEncoding::id() const { return 2; }
 
-    for (int i = 0; i < encoded.length(); i++) {
-        std::string charKey = (!key.empty() ? key.substr(i % key.length(), 1) : "") + std::to_string(i);
-        decoded += subEncoder.decode(encoded.substr(i, 1), charKey);
-    }
+std::shared_ptr<const KeySchedule> ShiftCharEncoding::prepare(const std::string& key, const std::string& nonce) const {
+    return std::make_shared<ShiftCharSchedule>(key);
+}
 
-    return decoded;
+void ShiftCharEncoding::decode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    const ShiftCharSchedule& shiftChar = scheduleAs<ShiftCharSchedule>(schedule);
+    shiftByKeystream(text, length, shiftChar.key, shiftChar.cacheDigest, shiftKernels().downEach, threads);
 }
 
-std::string ShiftCharEncoding::encode(const std::string raw, const std::string& key) {
-    std::string encoded;
-    ShiftAllEncoding subEncoder = ShiftAllEncoding();
+void ShiftCharEncoding::encode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    const ShiftCharSchedule& shiftChar = scheduleAs<ShiftCharSchedule>(schedule);
+    shiftByKeystream(text, length, shiftChar.key, shiftChar.cacheDigest, shiftKernels().upEach, threads);
+}
 
-    for (int i = 0; i < raw.length(); i++) {
-        std::string charKey = (!key.empty() ? key.substr(i % key.length(), 1) : "") + std::to_string(i);
-        encoded += subEncoder.encode(raw.substr(i, 1), charKey);
-    }
+void ShiftCharEncoding::decodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    const ShiftCharSchedule& shiftChar = scheduleAs<ShiftCharSchedule>(schedule);
+    shiftByKeystream(bytes, length, shiftChar.key, shiftChar.cacheDigest, subtractEach, threads);
+}
 
-    return encoded;
+void ShiftCharEncoding::encodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    const ShiftCharSchedule& shiftChar = scheduleAs<ShiftCharSchedule>(schedule);
+    shiftByKeystream(bytes, length, shiftChar.key, shiftChar.cacheDigest, addEach, threads);
+}
+
+void ShiftCharEncoding::encodeAt(char* text, const size_t length, const size_t position, const KeySchedule& schedule) const {
+    shiftRange(text, length, position, scheduleAs<ShiftCharSchedule>(schedule).key, shiftKernels().upEach);
+}
+
+void ShiftCharEncoding::encodeBytesAt(char* bytes, const size_t length, const size_t position, const KeySchedule& schedule) const {
+    shiftRange(bytes, length, position, scheduleAs<ShiftCharSchedule>(schedule).key, addEach);
+}
+
+// AesCtrEncoding implementation
+std::string AesCtrEncoding::name() const { return "aesctr"; }
+
+uint8_t AesCtrEncoding::id() const { return 3; }
+
+size_t AesCtrEncoding::nonceSize() const { return aesBlockSize; }
+
+std::shared_ptr<const KeySchedule> AesCtrEncoding::prepare(const std::string& key, const std::string& nonce) const {
+    std::array<uint8_t, aesBlockSize> counter{};
+    std::copy_n(nonce.begin(), std::min(nonce.length(), counter.size()), counter.begin());
+    return std::make_shared<AesCtrSchedule>(AesCtr(sha256(key), counter));
+}
+
+void AesCtrEncoding::decode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    encodeBytes(text, length, schedule, threads);
+}
+
+void AesCtrEncoding::encode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    encodeBytes(text, length, schedule, threads);
+}
+
+void AesCtrEncoding::decodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    encodeBytes(bytes, length, schedule, threads);
+}
+
+void AesCtrEncoding::encodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    const AesCtr& aes = scheduleAs<AesCtrSchedule>(schedule).aes;
+    forEachChunk(length, threads, [&](const size_t begin, const size_t end) {
+        aes.apply(bytes + begin, end - begin, begin);
+    });
+}
+
+void AesCtrEncoding::encodeAt(char* text, const size_t length, const size_t position, const KeySchedule& schedule) const {
+    encodeBytesAt(text, length, position, schedule);
+}
+
+void AesCtrEncoding::encodeBytesAt(char* bytes, const size_t length, const size_t position, const KeySchedule& schedule) const {
+    scheduleAs<AesCtrSchedule>(schedule).aes.apply(bytes, length, position);
+}
+
+// HashCharEncoding implementation
+std::string HashCharEncoding::name() const { return "hashchar"; }
+
+uint8_t HashCharEncoding::id() const { return 4; }
+
+// Shifting a character up to exactly 128 wraps it around to a null character, which would end a search for the text
+bool HashCharEncoding::requiresHeader() const { return true; }
+
+std::shared_ptr<const KeySchedule> HashCharEncoding::prepare(const std::string& key, const std::string& nonce) const {
+    return std::make_shared<HashCharSchedule>(sha256(key));
+}
+
+void HashCharEncoding::decode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    shiftByHash(text, length, scheduleAs<HashCharSchedule>(schedule).seed, shiftKernels().downEach, threads);
+}
+
+void HashCharEncoding::encode(char* text, const size_t length, const KeySchedule& schedule, const int threads) const {
+    shiftByHash(text, length, scheduleAs<HashCharSchedule>(schedule).seed, shiftKernels().upEach, threads);
+}
+
+void HashCharEncoding::decodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    shiftByHash(bytes, length, scheduleAs<HashCharSchedule>(schedule).seed, subtractEach, threads);
+}
+
+void HashCharEncoding::encodeBytes(char* bytes, const size_t length, const KeySchedule& schedule, const int threads) const {
+    shiftByHash(bytes, length, scheduleAs<HashCharSchedule>(schedule).seed, addEach, threads);
+}
+
+void HashCharEncoding::encodeAt(char* text, const size_t length, const size_t position, const KeySchedule& schedule) const {
+    hashRange(text, length, position, scheduleAs<HashCharSchedule>(schedule).seed, shiftKernels().upEach);
+}
+
+void HashCharEncoding::encodeBytesAt(char* bytes, const size_t length, const size_t position, const KeySchedule& schedule) const {
+    hashRange(bytes, length, position, scheduleAs<HashCharSchedule>(schedule).seed, addEach);
 }
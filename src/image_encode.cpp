@@ -4,181 +4,658 @@
 
 #include "image_encode.h"
 
-#include <random>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+#include "embed_kernels.h"
+#include "tail_noise.h"
 
 
 /**
- * Preprocesses the image by rounding the pixel values to the nearest multiple of the bit width
- * @param image The image to preprocess
- * @param bitWidth The number of bits to use for encoding within each channel (1, 2, or 4)
+ * The maximum number of characters that are embedded or extracted by a single kernel call
  */
-void preprocessImage(cv::Mat& image, const int bitWidth) {
+constexpr size_t embedBlockSize = 4096;
 
-    const int bitMax = 1 << bitWidth;  // The maximum value that each channel can vary by
-    for (int i = 0; i<image.rows; i++) {
-        for (int j = 0; j<image.cols; j++) {
 
-            cv::Vec4b pixel = image.at<cv::Vec4b>(i, j);
-            // Ground the pixel values to the nearest multiple of the bit width
-            pixel[0] = pixel[0] - (pixel[0] % bitMax);
-            pixel[1] = pixel[1] - (pixel[1] % bitMax);
-            pixel[2] = pixel[2] - (pixel[2] % bitMax);
-            pixel[3] = pixel[3] - (pixel[3] % bitMax);
+/**
+ * The number of message characters that encode bands and blocks are aligned to where possible.  This is a whole number
+ * of base64 groups and of the keystream blocks of every encoding, so that a message produced a block at a time never
+ * repeats work at the boundary between two blocks
+ */
+constexpr size_t messageAlignment = 32;
 
-            image.at<cv::Vec4b>(i, j) = pixel;
-        }
+
+/**
+ * The maximum number of pixels in each band when decoding in parallel.  Bands are decoded in rounds, so smaller bands
+ * stop sooner after the end of the message
+ */
+constexpr size_t decodeBandSize = 1 << 16;
+
+
+/**
+ * Describes how characters are laid out within the channels of an image.  Every function that walks the image is
+ * specialized for a format so that the layout constants are known at compile time
+ * @tparam BitWidth The number of bits used for encoding within each channel
+ * @tparam Channels The number of channels in each pixel
+ * @tparam Channel The type of each channel
+ */
+template<int BitWidth, int Channels, typename Channel>
+struct PixelFormat {
+
+    static constexpr int bitWidth = BitWidth;
+    static constexpr int channels = Channels;
+    using channel_type = Channel;
+
+    /**
+     * The number of characters in the smallest group whose bits fill a whole number of channels
+     */
+    static constexpr size_t groupChars = std::lcm(8, BitWidth) / 8;
+
+    /**
+     * The number of channels that each group of characters fills
+     */
+    static constexpr size_t groupChannels = std::lcm(8, BitWidth) / BitWidth;
+
+    /**
+     * The number of pixels in the smallest run that holds a whole number of groups
+     */
+    static constexpr size_t unitPixels = std::lcm(groupChannels, static_cast<size_t>(Channels)) / Channels;
+
+    /**
+     * The number of characters held by each run of unitPixels pixels
+     */
+    static constexpr size_t unitChars = unitPixels * Channels / groupChannels * groupChars;
+
+    /**
+     * The number of null characters written after the text, enough that one of them always ends a unit
+     */
+    static constexpr size_t terminatorLength = std::max<size_t>(unitChars, 2);
+
+    /**
+     * The number of pixels in the smallest run that holds a whole number of units and of messageAlignment characters,
+     * which encode bands start on
+     */
+    static constexpr size_t segmentPixels = std::lcm(unitChars, messageAlignment) / unitChars * unitPixels;
+
+    /**
+     * The number of groups of characters that are embedded by each kernel call, as many as fit in embedBlockSize while
+     * keeping every block aligned to messageAlignment characters
+     */
+    static constexpr size_t blockGroups = std::max<size_t>(
+        embedBlockSize / std::lcm(groupChars, messageAlignment) * std::lcm(groupChars, messageAlignment), groupChars) /
+        groupChars;
+
+    /**
+     * The mask that clears the bits of a channel used for encoding
+     */
+    static constexpr Channel groundMask = static_cast<Channel>(~((1u << BitWidth) - 1));
+};
+
+
+/**
+ * The kernels that ground, embed, and extract characters for one pixel format
+ * @tparam Format The pixel format
+ */
+template<typename Format>
+struct FormatKernels {
+    using Channel = typename Format::channel_type;
+
+    void (*ground)(Channel* channels, size_t length, Channel mask);
+    void (*embed)(Channel* channels, const char* chars, size_t count);
+    void (*extract)(const Channel* channels, char* chars, size_t count);
+};
+
+
+/**
+ * Selects the kernels for a pixel format.  The fastest kernels supported by the CPU are used where they exist
+ * @tparam Format The pixel format
+ * @return The selected kernels
+ */
+template<typename Format>
+FormatKernels<Format> formatKernels() {
+    using Channel = typename Format::channel_type;
+    constexpr int bitWidth = Format::bitWidth;
+
+    if constexpr (std::is_same_v<Channel, uchar>) {
+        const EmbedKernels& kernels = embedKernels();
+        if constexpr (bitWidth == 1) return {kernels.ground, kernels.embed1, kernels.extract1};
+        else if constexpr (bitWidth == 2) return {kernels.ground, kernels.embed2, kernels.extract2};
+        else if constexpr (bitWidth == 4) return {kernels.ground, kernels.embed4, kernels.extract4};
+        else return {kernels.ground, embedGeneric<bitWidth, uchar>, extractGeneric<bitWidth, uchar>};
+    } else return {groundGeneric<Channel>, embedGeneric<bitWidth, Channel>, extractGeneric<bitWidth, Channel>};
+}
+
+
+/**
+ * Calls a function with the pixel format of an image, selected by the number of channels in the image
+ * @tparam BitWidth The number of bits used for encoding within each channel
+ * @tparam Channel The type of each channel
+ * @param image The image to get the format of, which must have a supported number of channels
+ * @param function Called with a default-constructed PixelFormat
+ * @return The result of the function
+ */
+template<int BitWidth, typename Channel, typename Function>
+auto withChannels(const cv::Mat& image, Function function) {
+    switch (image.channels()) {
+        case 1: return function(PixelFormat<BitWidth, 1, Channel>{});
+        case 2: return function(PixelFormat<BitWidth, 2, Channel>{});
+        case 3: return function(PixelFormat<BitWidth, 3, Channel>{});
+        default: return function(PixelFormat<BitWidth, 4, Channel>{});
     }
 }
 
 
 /**
- * Adds an alpha channel to the image
- * @param image The image to add an alpha channel to
+ * Calls a function with the pixel format of an image, selected by the depth of the image
+ * @tparam BitWidth The number of bits used for encoding within each channel
+ * @param image The image to get the format of, which must have a supported depth
+ * @param function Called with a default-constructed PixelFormat
+ * @return The result of the function
+ */
+template<int BitWidth, typename Function>
+auto withDepth(const cv::Mat& image, Function function) {
+    if (image.depth() == CV_16U) return withChannels<BitWidth, ushort>(image, function);
+    return withChannels<BitWidth, uchar>(image, function);
+}
+
+
+/**
+ * Calls a function with the pixel format of an image.  This is the only place that the bit width is checked at runtime
+ * @param image The image to get the format of
+ * @param bitWidth The number of bits used for encoding within each channel, which must be supported
+ * @param function Called with a default-constructed PixelFormat
+ * @return The result of the function
  */
-void addAlphaChannel(cv::Mat& image) {
+template<typename Function>
+auto withFormat(const cv::Mat& image, const int bitWidth, Function function) {
+    switch (bitWidth) {
+        case 1: return withDepth<1>(image, function);
+        case 2: return withDepth<2>(image, function);
+        case 3: return withDepth<3>(image, function);
+        case 4: return withDepth<4>(image, function);
+        case 6: return withDepth<6>(image, function);
+        default: return withDepth<8>(image, function);
+    }
+}
 
-    std::cerr << "Warning: Image does not have an alpha channel. Adding an alpha channel to output image." << std::endl;
-    std::vector<cv::Mat> matChannels;
-    split(image, matChannels);
 
-    // Create alpha channel
-    const cv::Mat alpha = cv::Mat::ones(image.size(), CV_8UC1) * 255;
-    matChannels.push_back(alpha);
-    merge(matChannels, image);
+std::vector<int> supportedBitWidths() { return {1, 2, 3, 4, 6, 8}; }
+
+
+bool isSupportedBitWidth(const int bitWidth) {
+    const std::vector<int> bitWidths = supportedBitWidths();
+    return std::find(bitWidths.begin(), bitWidths.end(), bitWidth) != bitWidths.end();
 }
 
 
 /**
- * Gets the character at the given index in the text, or a random character if the index is out of bounds
- * @param text The text to get the character from
- * @param index The index of the character to get
- * @return The character at the given index in the text, or a random character if the index is out of bounds
+ * Calls the given kernel on each row segment within a range of pixels.  A continuous image is treated as a single row
+ * @tparam Format The pixel format of the image
+ * @param image The image to walk over
+ * @param begin The index of the first pixel of the range
+ * @param end The index after the last pixel of the range
+ * @param kernel Called with a pointer to the first channel of the segment, the number of pixels in the segment, and the
+ * index of the segment's first pixel within the image.  Returns false to stop walking early
  */
-char getChar(const std::string& text, const int index) {
-    if (index < text.length())
-        return text[index];
-    if (index > text.length() + 1) {  // Add noise outside the text to disguise the end of the message
-        std::random_device dev;
-        std::mt19937 rng(dev());
-        std::uniform_int_distribution<std::mt19937::result_type> dist6(0,63);  // Random character from base64
+template<typename Format, typename Kernel>
+void forEachSpan(cv::Mat& image, size_t begin, const size_t end, Kernel kernel) {
+    using Channel = typename Format::channel_type;
+
+    // Continuous images have no padding between rows, so they can be walked as one long row
+    if (image.isContinuous()) {
+        if (begin < end) kernel(image.ptr<Channel>() + begin * Format::channels, end - begin, begin);
+        return;
+    }
 
-        return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[dist6(rng) % 64];
+    const size_t cols = image.cols;
+    while (begin < end) {
+        const size_t col = begin % cols;
+        const size_t count = std::min(cols - col, end - begin);
+        if (!kernel(image.ptr<Channel>(static_cast<int>(begin / cols)) + col * Format::channels, count, begin)) return;
+        begin += count;
     }
-    return 0;
 }
 
 
-void encodeText(cv::Mat& image, const std::string& text, const int bitWidth) {
+/**
+ * Gets the number of bands to split an image into for the given number of threads
+ * @param threads The requested number of threads, or 0 to use all available threads
+ * @return The number of bands
+ */
+int bandCount(const int threads) { return threads > 0 ? threads : std::max(cv::getNumThreads(), 1); }
+
+
+/**
+ * Rounds a number up to the next multiple
+ * @param value The number to round
+ * @param multiple The multiple to round to
+ * @return The rounded number
+ */
+size_t roundUp(const size_t value, const size_t multiple) { return (value + multiple - 1) / multiple * multiple; }
 
-    // Add an alpha channel if the image does not have one and ground the pixel values
-    if (image.channels() == 3) addAlphaChannel(image);
-    preprocessImage(image, bitWidth);
 
-    int textIndex = 0;
-    bool evenPixel = true;
+/**
+ * Exits if the image does not have a channel depth and number of channels that text can be encoded into
+ * @param image The image to encode into or decode from
+ */
+void requireSupportedImage(const cv::Mat& image) {
+    if (image.depth() != CV_8U && image.depth() != CV_16U) {
+        std::cerr << "Error: Only images with 8-bit or 16-bit unsigned channels are supported." << std::endl;
+        exit(-1);
+    }
+    if (image.channels() < 1 || image.channels() > 4) {
+        std::cerr << "Error: Images with " << image.channels() << " channels are not supported." << std::endl;
+        exit(-1);
+    }
+}
 
-    for (int i = 0; i<image.rows; i++) {
-        for (int j = 0; j<image.cols; j++) {
 
-            cv::Vec4b pixel = image.at<cv::Vec4b>(i, j);
+/**
+ * A message whose characters are all held in a string
+ */
+class TextMessage final : public MessageSource {
 
-            char current = getChar(text, textIndex);
+    const std::string& text;
 
-            // 1-Bit encoding: encode the text over two pixels
-            if (bitWidth == 1) {
-                // Add each quartet of bits in reverse order like [3210][7654]
-                const int shift = evenPixel ? 4 : 0;
-                for (int k = 0; k < 4; k++)
-                    pixel[k] += (current >> (k + shift)) & 1;
-                // Process character every other pixel
-                if (!evenPixel) textIndex++;
-            }
-            // 2-Bit encoding: encode the text over one pixel
-            else if (bitWidth == 2) {
-                // Add each pair of bits in reverse order like [67452301]
-                for (int k = 0; k < 4; k++)
-                    pixel[k] += ((current >> (k * 2)) & 1) + (((current >> (k * 2 + 1)) & 1) << 1);
-                textIndex++;
-            }
-            // 4-Bit encoding: encode the text over two pixel channels
-            else if (bitWidth == 4) {
-                // Add two octets of bits in order in each pixel like [01234567 01234567]
-                for (int k = 0; k < 2; k++) {
-                    for (int l = 0; l < 4; l++)  // First 4 bits in the first channel
-                        pixel[k * 2 + 1] += ((current >> l) & 1) << (3 - l);
-                    for (int l = 4; l < 8; l++)  // Last 4 bits in the second channel
-                        pixel[k * 2] += ((current >> l) & 1) << (7 - l);
-                    textIndex++;
-                    current = getChar(text, textIndex);
-                }
-            }
+public:
+
+    explicit TextMessage(const std::string& text) : text(text) {}
+
+    size_t length() const override { return text.length(); }
+
+    const char* chars(const size_t index, size_t, char*) const override { return text.data() + index; }
+};
+
+
+/**
+ * Gets a run of consecutive characters from the message, padded with the message terminator and noise
+ * @param message The message to get the characters from
+ * @param index The index of the first character to get
+ * @param count The number of characters to get
+ * @param noise The noise to disguise the end of the message with
+ * @param terminatorLength The number of null characters that terminate the text
+ * @param buffer A buffer of at least count characters to assemble the characters in, if needed
+ * @return A pointer to the characters
+ */
+const char* getChars(const MessageSource& message, const size_t index, const size_t count, const TailNoise& noise,
+                     const size_t terminatorLength, char* buffer) {
+    const size_t end = index + count;
+    const size_t length = message.length();
+    if (end <= length)
+        return message.chars(index, count, buffer);  // Entirely within the message, so it needs no padding
+
+    // Copy any remaining text, then the null characters that terminate it, then fill the rest with noise
+    const size_t textEnd = std::clamp(length, index, end);
+    const size_t noiseStart = std::clamp(length + terminatorLength, index, end);
+    if (textEnd > index) {
+        const char* chars = message.chars(index, textEnd - index, buffer);
+        if (chars != buffer) std::copy(chars, chars + (textEnd - index), buffer);
+    }
+    std::fill(buffer + (textEnd - index), buffer + (noiseStart - index), '\0');
+    noise.fill(buffer + (noiseStart - index), noiseStart, end - noiseStart);
+    return buffer;
+}
+
+
+/**
+ * Grounds a run of channels and embeds the text into them.  Each block of channels is grounded right before it is
+ * embedded into so that it is only brought into cache once
+ * @tparam Format The pixel format of the image
+ * @param channels The first channel of the run
+ * @param first The index of the first channel of the run within the image
+ * @param length The number of channels in the run
+ * @param message The message to encode
+ * @param kernels The kernels to ground and embed with
+ * @param noise The noise to disguise the end of the message with
+ */
+template<typename Format>
+void embedSpan(typename Format::channel_type* channels, const size_t first, size_t length, const MessageSource& message,
+               const FormatKernels<Format>& kernels, const TailNoise& noise) {
+    using Channel = typename Format::channel_type;
+    constexpr size_t groupChars = Format::groupChars;
+    constexpr size_t groupChannels = Format::groupChannels;
+
+    size_t index = first / groupChannels * groupChars;
+    Channel spread[groupChannels];
+    char group[groupChars];
+
+    // The run starts partway through a group of characters that began on the previous row
+    if (const size_t offset = first % groupChannels) {
+        std::fill_n(spread, groupChannels, 0);
+        kernels.embed(spread, getChars(message, index, groupChars, noise, Format::terminatorLength, group), groupChars);
+        index += groupChars;
+        const size_t count = std::min(groupChannels - offset, length);
+        kernels.ground(channels, count, Format::groundMask);
+        for (size_t i = 0; i < count; i++) channels[i] |= spread[offset + i];
+        channels += count;
+        length -= count;
+    }
+
+    // Embed whole groups of characters in blocks
+    char buffer[embedBlockSize];
+    while (length >= groupChannels) {
+        const size_t groups = std::min(length / groupChannels, Format::blockGroups);
+        kernels.ground(channels, groups * groupChannels, Format::groundMask);
+        kernels.embed(channels, getChars(message, index, groups * groupChars, noise, Format::terminatorLength, buffer),
+                      groups * groupChars);
+        channels += groups * groupChannels;
+        length -= groups * groupChannels;
+        index += groups * groupChars;
+    }
+
+    // The run ends partway through a group of characters that continues on the next row
+    if (length > 0) {
+        std::fill_n(spread, groupChannels, 0);
+        kernels.embed(spread, getChars(message, index, groupChars, noise, Format::terminatorLength, group), groupChars);
+        kernels.ground(channels, length, Format::groundMask);
+        for (size_t i = 0; i < length; i++) channels[i] |= spread[i];
+    }
+}
+
+
+/**
+ * Encodes a message into an image with a known pixel format
+ * @tparam Format The pixel format of the image
+ * @param image The image to encode the message into
+ * @param message The message to encode
+ * @param threads The number of threads to embed with, or 0 to use all available threads
+ * @param noise The noise to disguise the end of the message with
+ * @param noiseLength The number of characters of noise to add after the end of the message
+ */
+template<typename Format>
+void encodeFormat(cv::Mat& image, const MessageSource& message, const int threads, const TailNoise& noise,
+                  const size_t noiseLength) {
+    using Channel = typename Format::channel_type;
+
+    // Select the kernels once so that the CPU is not checked for every pixel
+    const FormatKernels<Format> kernels = formatKernels<Format>();
+    const auto encodeBand = [&](const size_t begin, const size_t end) {
+        forEachSpan<Format>(image, begin, end, [&](Channel* row, const size_t cols, const size_t pixelIndex) {
+            embedSpan<Format>(row, pixelIndex * Format::channels, cols * Format::channels, message, kernels, noise);
+            return true;
+        });
+    };
+
+    // Only the pixels that hold the text, its terminator, and the noise after it are touched.  The last unit is
+    // filled so that the message still ends on a pixel boundary
+    size_t pixels = image.total();
+    const size_t capacity = pixels / Format::unitPixels * Format::unitChars;
+    if (noiseLength < capacity) {
+        const size_t chars = message.length() + Format::terminatorLength + noiseLength;
+        pixels = std::min(pixels, (chars + Format::unitChars - 1) / Format::unitChars * Format::unitPixels);
+    }
+
+    const int bands = bandCount(threads);
+    if (bands == 1) {
+        encodeBand(0, pixels);
+        return;
+    }
+
+    // The character at each pixel only depends on the pixel's index, so bands can be embedded independently.  Each band
+    // is a whole number of segments, so it produces its own run of the message from start to end, including the base64
+    // groups and keystream blocks, and embeds it into its own pixels
+    const size_t segments = (pixels + Format::segmentPixels - 1) / Format::segmentPixels;
+    const auto bandStart = [&](const int band) { return std::min(pixels, segments * band / bands * Format::segmentPixels); };
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+        for (int band = range.start; band < range.end; band++) encodeBand(bandStart(band), bandStart(band + 1));
+    }, bands);
+}
+
+
+void encodeText(cv::Mat& image, const std::string& text, const int bitWidth, const int threads, const uint64_t noiseSeed,
+                const size_t noiseLength) {
+    encodeMessage(image, TextMessage(text), bitWidth, threads, noiseSeed, noiseLength);
+}
+
+
+void encodeMessage(cv::Mat& image, const MessageSource& message, const int bitWidth, const int threads,
+                   const uint64_t noiseSeed, const size_t noiseLength) {
+
+    if (!isSupportedBitWidth(bitWidth)) return;
+    requireSupportedImage(image);
+
+    const TailNoise noise(noiseSeed);
+    withFormat(image, bitWidth, [&](auto format) {
+        encodeFormat<decltype(format)>(image, message, threads, noise, noiseLength);
+    });
+}
+
+
+/**
+ * Checks whether a null character marks the end of the message.  Only the last character of a unit can mark the end,
+ * so that the message always ends on a pixel boundary
+ * @tparam Format The pixel format of the image
+ * @param index The index of the null character within the message
+ * @return True if the character ends a unit
+ */
+template<typename Format>
+bool endsUnit(const size_t index) { return (index + 1) % Format::unitChars == 0; }
 
-            image.at<cv::Vec4b>(i, j) = pixel;
-            evenPixel = !evenPixel;
+
+/**
+ * Appends a run of decoded characters to the text, stopping after the first one that marks the end of the message
+ * @tparam Format The pixel format of the image
+ * @param text The text to append the characters to
+ * @param chars The decoded characters
+ * @param count The number of decoded characters
+ * @param index The index of the first decoded character within the message
+ * @param findEnd Whether to stop at the end of the message, or to append every character
+ * @return True if the end of the message was found
+ */
+template<typename Format>
+bool appendChars(std::string& text, const char* chars, const size_t count, const size_t index, const bool findEnd) {
+    if (!findEnd) {
+        text.append(chars, count);
+        return false;
+    }
+    for (const char* terminator = std::find(chars, chars + count, '\0'); terminator != chars + count;
+         terminator = std::find(terminator + 1, chars + count, '\0')) {
+        if (endsUnit<Format>(index + (terminator - chars))) {
+            text.append(chars, terminator + 1);
+            return true;
         }
     }
+    text.append(chars, count);
+    return false;
 }
 
 
-std::string decodeText(cv::Mat& image, const int bitWidth) {
+/**
+ * Extracts the text from a run of channels
+ * @tparam Format The pixel format of the image
+ * @param channels The first channel of the run
+ * @param first The index of the first channel of the run within the image
+ * @param length The number of channels in the run
+ * @param text The text to append the decoded characters to
+ * @param extract The kernel to extract whole groups of characters with
+ * @param partial The channels of a group of characters that began on the previous row
+ * @param findEnd Whether to stop at the end of the message, or to extract every character
+ * @return True if the end of the message was found
+ */
+template<typename Format>
+bool extractSpan(const typename Format::channel_type* channels, const size_t first, size_t length, std::string& text,
+                 decltype(FormatKernels<Format>::extract) extract, typename Format::channel_type* partial,
+                 const bool findEnd) {
+    constexpr size_t groupChars = Format::groupChars;
+    constexpr size_t groupChannels = Format::groupChannels;
+
+    size_t index = first / groupChannels * groupChars;
+    char buffer[embedBlockSize];
+
+    // Finish the group of characters that began on the previous row
+    if (const size_t offset = first % groupChannels) {
+        const size_t count = std::min(groupChannels - offset, length);
+        std::copy_n(channels, count, partial + offset);
+        channels += count;
+        length -= count;
+        if (offset + count == groupChannels) {
+            extract(partial, buffer, groupChars);
+            if (appendChars<Format>(text, buffer, groupChars, index, findEnd)) return true;
+            index += groupChars;
+        }
+    }
 
-    if (image.channels() == 3) {
-        std::cerr << "Error: Image does not have an alpha channel. Cannot decode." << std::endl;
-        exit(-1);
+    // Extract whole groups of characters in blocks so that decoding stops soon after the end of the message
+    while (length >= groupChannels) {
+        const size_t groups = std::min(length / groupChannels, embedBlockSize / groupChars);
+        extract(channels, buffer, groups * groupChars);
+        if (appendChars<Format>(text, buffer, groups * groupChars, index, findEnd)) return true;
+        channels += groups * groupChannels;
+        length -= groups * groupChannels;
+        index += groups * groupChars;
     }
 
-    std::string text;
-    unsigned char character = 0;
-    bool evenPixel = true;
+    // Save the start of a group of characters that continues on the next row
+    std::copy_n(channels, length, partial);
+    return false;
+}
 
-    for (int i = 0; i<image.rows; i++) {
-        for (int j = 0; j<image.cols; j++) {
 
-            cv::Vec4b pixel = image.at<cv::Vec4b>(i, j);
+/**
+ * Decodes the text from a range of pixels that starts on a unit boundary
+ * @tparam Format The pixel format of the image
+ * @param image The image to decode the text from
+ * @param begin The index of the first pixel of the range
+ * @param end The index after the last pixel of the range
+ * @param extract The kernel to extract whole groups of characters with
+ * @param text The text to append the decoded characters to
+ * @param findEnd Whether to stop at the end of the message, or to decode every character
+ * @return True if the end of the message was found
+ */
+template<typename Format>
+bool decodeBand(cv::Mat& image, const size_t begin, const size_t end, decltype(FormatKernels<Format>::extract) extract,
+                std::string& text, const bool findEnd) {
+    using Channel = typename Format::channel_type;
+
+    Channel partial[Format::groupChannels];
+    bool terminated = false;
+    forEachSpan<Format>(image, begin, end, [&](const Channel* row, const size_t cols, const size_t pixelIndex) {
+        terminated = extractSpan<Format>(row, pixelIndex * Format::channels, cols * Format::channels, text, extract,
+                                         partial, findEnd);
+        return !terminated;
+    });
+    return terminated;
+}
 
-            // 1-Bit decoding: decode the text from two pixels
-            if (bitWidth == 1) {
-                const int shift = evenPixel ? 4 : 0;
-                for (int k = 0; k < 4; k++)
-                    character |= (pixel[k] % 2) << (k + shift);
 
-                // Process character every other pixel
-                if (!evenPixel) {
-                    text += static_cast<char>(character);
-                    character = 0;
-                }
+/**
+ * Decodes text from an image with a known pixel format, stopping at the end of the message
+ * @tparam Format The pixel format of the image
+ * @param image The image to decode the text from
+ * @param threads The number of threads to extract with, or 0 to use all available threads
+ * @return The decoded text
+ */
+template<typename Format>
+std::string decodeFormat(cv::Mat& image, const int threads) {
 
-                evenPixel = !evenPixel;
-            }
-            // 2-Bit decoding: decode the text from one pixel
-            else if (bitWidth == 2) {
-                for (int k = 0; k < 8; k++)
-                    character |= (((pixel[k / 2] % 4) >> (k % 2)) & 1) << k;
+    const auto extract = formatKernels<Format>().extract;
+    const size_t pixels = image.total();
+    const int bands = bandCount(threads);
 
-                text += static_cast<char>(character);
-                character = 0;
-            }
-            // 4-Bit decoding: decode the text from two pixel channels
-            else if (bitWidth == 4) {
-                for (int k = 0; k < 2; k++) {
-                    int pixelIdx = k * 2;
-                    for (int l = 0; l<8; l++) {
-                        character |= (((pixel[pixelIdx] % 16) >> (l % 4)) & 1) << (7 - l);
-                        if (l == 3) pixelIdx++;
-                    }
-
-                    text += static_cast<char>(character);
-                    character = 0;
+    std::string text;
+    bool terminated = false;
+
+    if (bands == 1) terminated = decodeBand<Format>(image, 0, pixels, extract, text, true);
+    else {
+        // Bands hold a whole number of units so that no group of characters is split between two bands
+        const size_t bandSize = roundUp(std::min(decodeBandSize, pixels / bands + 1), Format::unitPixels);
+        std::vector<std::string> bandText(bands);
+        std::vector<char> bandTerminated(bands);
+
+        // Decode the bands in rounds, then join them in order up to the first band that holds the end of the message
+        for (size_t round = 0; round < pixels && !terminated; round += bandSize * bands) {
+            cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+                for (int band = range.start; band < range.end; band++) {
+                    const size_t begin = std::min(round + band * bandSize, pixels);
+                    bandText[band].clear();
+                    bandTerminated[band] = decodeBand<Format>(image, begin, std::min(begin + bandSize, pixels),
+                                                              extract, bandText[band], true);
                 }
-            }
+            }, bands);
 
-            // Check for the end of the message
-            if (!text.empty() && text.back() == '\0') {
-                while (text.back() == '\0') text.pop_back();  // Remove null bytes at the end of the message
-                return text;
+            for (int band = 0; band < bands && !terminated; band++) {
+                text += bandText[band];
+                terminated = bandTerminated[band];
             }
         }
     }
 
+    // Remove null bytes at the end of the message
+    if (terminated)
+        while (!text.empty() && text.back() == '\0') text.pop_back();
+
     return text;
 }
+
+
+/**
+ * Decodes a fixed range of characters from an image with a known pixel format
+ * @tparam Format The pixel format of the image
+ * @param image The image to decode the characters from
+ * @param index The index of the first character to decode
+ * @param count The number of characters to decode
+ * @param threads The number of threads to extract with, or 0 to use all available threads
+ * @return The decoded characters
+ */
+template<typename Format>
+std::string decodeCharsFormat(cv::Mat& image, const size_t index, const size_t count, const int threads) {
+
+    // Start on a unit boundary so that the range begins on a group boundary, then skip the characters before the index
+    const size_t pixels = image.total();
+    const size_t begin = std::min(index / Format::unitChars * Format::unitPixels, pixels);
+    const size_t endUnit = (index + count + Format::unitChars - 1) / Format::unitChars;
+    const size_t end = std::min(endUnit * Format::unitPixels, pixels);
+    const size_t skip = index - begin / Format::unitPixels * Format::unitChars;
+
+    const auto extract = formatKernels<Format>().extract;
+    const int bands = static_cast<int>(std::min<size_t>(bandCount(threads), (end - begin) / Format::unitPixels + 1));
+
+    std::string text;
+    text.reserve(skip + count + Format::unitChars);
+    if (bands == 1) decodeBand<Format>(image, begin, end, extract, text, false);
+    else {
+        const size_t bandSize = roundUp((end - begin) / bands + 1, Format::unitPixels);
+        std::vector<std::string> bandText(bands);
+        cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+            for (int band = range.start; band < range.end; band++) {
+                const size_t bandBegin = std::min(begin + band * bandSize, end);
+                decodeBand<Format>(image, bandBegin, std::min(bandBegin + bandSize, end), extract, bandText[band], false);
+            }
+        }, bands);
+        for (const std::string& band : bandText) text += band;
+    }
+
+    return skip < text.length() ? text.substr(skip, count) : "";
+}
+
+
+std::string decodeText(cv::Mat& image, const int bitWidth, const int threads) {
+
+    if (!isSupportedBitWidth(bitWidth)) return "";
+    requireSupportedImage(image);
+
+    return withFormat(image, bitWidth, [&](auto format) { return decodeFormat<decltype(format)>(image, threads); });
+}
+
+
+std::string decodeChars(cv::Mat& image, const int bitWidth, const size_t index, const size_t count, const int threads) {
+
+    if (!isSupportedBitWidth(bitWidth) || count == 0) return "";
+    requireSupportedImage(image);
+
+    return withFormat(image, bitWidth, [&](auto format) {
+        return decodeCharsFormat<decltype(format)>(image, index, count, threads);
+    });
+}
+
+
+size_t textCapacity(const cv::Mat& image, const int bitWidth) {
+    if (!isSupportedBitWidth(bitWidth)) return 0;
+    requireSupportedImage(image);
+
+    return withFormat(image, bitWidth, [&](auto format) {
+        using Format = decltype(format);
+        return image.total() * Format::channels / Format::groupChannels * Format::groupChars;
+    });
+}
@@ -0,0 +1,291 @@
+//
+// Created by matthew on 3/9/25.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "keystream_cache.h"
+
+
+/**
+ * Marks the start of a keystream cache file
+ */
+static constexpr char cacheMagic[] = {'\x89', 'I', 'C', 'K'};
+
+
+/**
+ * The newest keystream cache format version.  Files with any other version are rebuilt
+ */
+static constexpr uint8_t cacheVersion = 3;
+
+
+/**
+ * Separates the key digests of cache files from every other digest of the key
+ */
+static constexpr char keyDigestDomain[] = "icrypt-keystream";
+
+
+/**
+ * The number of shifts in each block of a cache file that has its own checksum, so that reading the start of a long
+ * keystream only checks the blocks that are read.  Cache files are also extended a block at a time
+ */
+static constexpr size_t cacheBlock = 1 << 20;
+
+
+/**
+ * The number of shifts at each end of a cached keystream that are generated again and compared when it is opened, which
+ * catches caches written by a build whose shifts differ
+ */
+static constexpr size_t spotCheckLength = 64;
+
+
+/**
+ * The header at the start of every keystream cache file, which is followed by the CRC-32 of each block of shifts and
+ * then the shifts
+ */
+struct CacheHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t reserved[3];
+    uint64_t length;
+    uint32_t checksum;  // The CRC-32 of the block checksums
+    uint8_t reserved2[4];
+    uint8_t keyDigest[sha256Size];
+};
+
+static_assert(sizeof(CacheHeader) == 56, "The cache header must have no padding");
+
+
+static std::string cacheDirectory;
+
+
+/**
+ * Creates a directory and any missing parents.  The directories that are created can only be accessed by their owner,
+ * since the keystreams inside decode anything that their keys encoded.  Existing directories are left as they are
+ * @param directory The directory to create
+ * @return True if the directory exists, false if it could not be created
+ */
+static bool createPrivateDirectories(const std::filesystem::path& directory) {
+    std::filesystem::path partial;
+    for (const std::filesystem::path& component : directory) {
+        partial /= component;
+        if (mkdir(partial.c_str(), 0700) != 0 && errno != EEXIST) return false;
+    }
+    return std::filesystem::is_directory(directory);
+}
+
+
+/**
+ * Writes a whole buffer to a file descriptor
+ * @param fd The file descriptor to write to
+ * @param data The data to write
+ * @param length The length of the data
+ * @return True if every byte was written, false if writing failed
+ */
+static bool writeAll(const int fd, const void* data, size_t length) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        const ssize_t written = write(fd, bytes, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+
+void setKeystreamCacheDirectory(const std::string& directory) { cacheDirectory = directory; }
+
+
+const std::string& keystreamCacheDirectory() { return cacheDirectory; }
+
+
+/**
+ * Gets the number of checksummed blocks that a keystream is split into
+ * @param length The number of shifts in the keystream
+ * @return The number of blocks, the last of which may be partial
+ */
+static size_t blocksOf(const size_t length) { return (length + cacheBlock - 1) / cacheBlock; }
+
+
+/**
+ * Computes the CRC-32 of a buffer of any length
+ * @param crc The CRC-32 of the preceding data, or 0 to start a new one
+ * @param data The data to checksum
+ * @param length The length of the data
+ * @return The combined CRC-32
+ */
+static uint32_t checksumOf(uLong crc, const uint8_t* data, size_t length) {
+    // zlib takes the length as an unsigned int, so large buffers are checked in pieces
+    for (size_t piece; length > 0; data += piece, length -= piece) {
+        piece = std::min<size_t>(length, 1u << 30);
+        crc = crc32(crc, data, static_cast<uInt>(piece));
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+
+std::array<uint8_t, sha256Size> keystreamCacheDigest(const std::string& key) { return sha256(keyDigestDomain + key); }
+
+
+KeystreamCache::KeystreamCache(const std::string& directory, const std::string& key, Generator generate)
+    : KeystreamCache(directory, keystreamCacheDigest(key), std::move(generate)) {}
+
+
+KeystreamCache::KeystreamCache(const std::string& directory, const std::array<uint8_t, sha256Size>& keyDigest,
+                               Generator generate)
+    : keyDigest(keyDigest), generate(std::move(generate)) {
+
+    // Only the digest of the key is stored, in both the name and the header, and the digest is the same on every build
+    char name[sha256Size * 2 + sizeof(".keystream")];
+    for (size_t i = 0; i < sha256Size; i++) snprintf(name + i * 2, 3, "%02x", keyDigest[i]);
+    snprintf(name + sha256Size * 2, sizeof(".keystream"), ".keystream");
+    path = (std::filesystem::path(directory) / name).string();
+
+    if (!map() && std::filesystem::exists(path))
+        std::cerr << "Warning: Rebuilding the stale or corrupt keystream cache " << path << std::endl;
+}
+
+
+KeystreamCache::~KeystreamCache() { unmap(); }
+
+
+bool KeystreamCache::map() {
+
+    const int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) return false;
+    struct stat status{};
+    const bool sized = fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(CacheHeader);
+    void* data = sized ? mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    mapped = static_cast<const uint8_t*>(data);
+    mappedSize = status.st_size;
+
+    // Only the header and block checksums are checked here.  Each block of shifts is checked the first time it is read
+    CacheHeader header{};
+    memcpy(&header, mapped, sizeof(header));
+    const size_t checksumsSize = blocksOf(header.length) * sizeof(uint32_t);
+    bool valid = memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 && header.version == cacheVersion &&
+                 memcmp(header.keyDigest, keyDigest.data(), sha256Size) == 0 &&
+                 header.length <= mappedSize - sizeof(header) &&
+                 header.length + checksumsSize == mappedSize - sizeof(header) &&
+                 checksumOf(0, mapped + sizeof(header), checksumsSize) == header.checksum;
+    if (valid) {
+        cachedLength = header.length;
+        cached = mapped + sizeof(header) + checksumsSize;
+    }
+
+    // The checksums only prove that the file is intact, so also check that this build generates the same shifts
+    if (valid) {
+        uint8_t expected[spotCheckLength];
+        const size_t count = std::min<size_t>(spotCheckLength, cachedLength);
+        for (const size_t index : {size_t{0}, cachedLength - count}) {
+            this->generate(expected, index, count);
+            valid = valid && memcmp(expected, cached + index, count) == 0;
+        }
+    }
+
+    if (!valid) unmap();
+    return valid;
+}
+
+
+void KeystreamCache::unmap() {
+    if (mapped) munmap(const_cast<uint8_t*>(mapped), mappedSize);
+    mapped = nullptr;
+    mappedSize = 0;
+    cached = nullptr;
+    cachedLength = 0;
+    checkedBlocks = 0;
+}
+
+
+bool KeystreamCache::blockIntact(const size_t block) const {
+    uint32_t expected;
+    memcpy(&expected, mapped + sizeof(CacheHeader) + block * sizeof(uint32_t), sizeof(expected));
+    const size_t begin = block * cacheBlock;
+    return checksumOf(0, cached + begin, std::min(cacheBlock, cachedLength - begin)) == expected;
+}
+
+
+bool KeystreamCache::extend(const size_t length) {
+
+    // Write to a new temporary file that only its owner can read and rename it over the cache, so that other processes
+    // never map a partial file.  mkstemp never opens an existing file, so a planted symlink cannot redirect the write
+    std::string tempPath = path + ".XXXXXX";
+    const int fd = createPrivateDirectories(std::filesystem::path(path).parent_path()) ? mkstemp(tempPath.data()) : -1;
+    if (fd < 0) {
+        std::cerr << "Warning: Could not write the keystream cache " << path << std::endl;
+        return false;
+    }
+
+    // The block checksums come before the shifts, so they are written last along with the header
+    CacheHeader header{};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    memcpy(header.keyDigest, keyDigest.data(), sha256Size);
+    header.length = length;
+    std::vector<uint32_t> checksums(blocksOf(length));
+    const size_t checksumsSize = checksums.size() * sizeof(uint32_t);
+    bool written = lseek(fd, static_cast<off_t>(sizeof(header) + checksumsSize), SEEK_SET) >= 0;
+
+    // Cached shifts are kept if their block is intact, and every other shift is generated
+    std::vector<uint8_t> block(std::min(cacheBlock, length));
+    for (size_t index = 0; index < length && written; index += cacheBlock) {
+        const size_t count = std::min(cacheBlock, length - index);
+        size_t kept = index < cachedLength ? std::min(count, cachedLength - index) : 0;
+        if (kept > 0 && (index / cacheBlock < checkedBlocks || blockIntact(index / cacheBlock)))
+            memcpy(block.data(), cached + index, kept);
+        else kept = 0;
+        if (kept < count) generate(block.data() + kept, index + kept, count - kept);
+
+        written = writeAll(fd, block.data(), count);
+        checksums[index / cacheBlock] = checksumOf(0, block.data(), count);
+    }
+
+    header.checksum = checksumOf(0, reinterpret_cast<const uint8_t*>(checksums.data()), checksumsSize);
+    written = written && pwrite(fd, &header, sizeof(header), 0) == sizeof(header) &&
+              pwrite(fd, checksums.data(), checksumsSize, sizeof(header)) == static_cast<ssize_t>(checksumsSize);
+    written = close(fd) == 0 && written;
+    if (!written || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        std::cerr << "Warning: Could not write the keystream cache " << path << std::endl;
+        return false;
+    }
+
+    unmap();
+    if (!map()) return false;
+    checkedBlocks = blocksOf(cachedLength);
+    return true;
+}
+
+
+const uint8_t* KeystreamCache::shifts(const size_t length) {
+    if ((!mapped || length > cachedLength) && !extend(length)) return nullptr;
+
+    // Check the blocks that are read for the first time, and rebuild the cache if any of them is corrupt
+    for (const size_t blocks = blocksOf(length); checkedBlocks < blocks; checkedBlocks++) {
+        if (!blockIntact(checkedBlocks)) {
+            std::cerr << "Warning: Rebuilding the stale or corrupt keystream cache " << path << std::endl;
+            return extend(cachedLength) ? cached : nullptr;
+        }
+    }
+    return cached;
+}
+
+
+size_t KeystreamCache::length() const { return cachedLength; }
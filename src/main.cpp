@@ -6,6 +6,10 @@
 #include "image_encode.h"
 #include "encodings.h"
 #include "base64.h"
+#include "payload_header.h"
+#include "compression.h"
+#include "keystream_cache.h"
+#include "pipeline.h"
 
 
 /**
@@ -43,27 +47,128 @@ std::string textFromStdin() {
 }
 
 
+/**
+ * Reads in the exact bytes of a file, or of stdin if no path is given
+ * @param path The path to the file, or an empty string to read from stdin
+ * @return The bytes of the file
+ */
+std::string bytesFromFile(const std::string& path) {
+    if (path.empty()) return {std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile.is_open()) {
+        std::cerr << "Could not open file" << std::endl;
+        exit(-1);
+    }
+    return {std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>()};
+}
+
+
 /**
  * Encodes the given text into the image
  * @param inputText The text to encode
- * @param image The image to encode the text into
+ * @param image The image to encode the text into, which is modified in place
  * @param outputImPth The path to write the output image to
- * @param bitWidth The number of bits to use for encoding within each channel (1, 2, or 4)
+ * @param bitWidth The number of bits to use for encoding within each channel
  * @param enc The encoding to use
  * @param key The key to encode with
+ * @param threads The number of threads to base64 encode, encode, and embed with, or 0 to use all available threads
+ * @param header Whether to write a payload header before the text
+ * @param noiseLength The number of characters of noise to add after the text, leaving the rest of the image untouched
+ * @param raw Whether to embed the bytes of the text as they are instead of base64 encoding them.  Implies header
+ * @param compression The level to compress the text with before embedding it, or 0 to leave it uncompressed.  Implies header
  */
-void encodeCommand(const std::string& inputText, const cv::Mat& image, const std::string& outputImPth, const int bitWidth, Encoding* enc, const std::string& key) {
-    const std::string b64Text = base64Encode(inputText);
-    const std::string hashEncText = enc->encode(b64Text, key);
-    const int overflow = static_cast<int>(hashEncText.length()) - (image.rows * image.cols);
-    if (overflow > 0)
-        std::cerr << "Warning: The last " << overflow << " characters of text will be truncated!" << std::endl;
-
-    // Encode the text into the image
-    cv::Mat outputImage = image.clone();
-    encodeText(outputImage, hashEncText, bitWidth);
+void encodeCommand(std::string inputText, cv::Mat& image, const std::string& outputImPth, const int bitWidth, const Encoding* enc, const std::string& key, const int threads, bool header, const size_t noiseLength, const bool raw, const int compression) {
+    // Raw bytes may hold null characters, so their length must come from the header, and so must whether to decompress.
+    // Some encodings store a nonce after the header or may encode characters as null characters too
+    header = header || raw || compression || enc->requiresHeader();
+    const size_t capacity = textCapacity(image, bitWidth);
+    if (compression) {
+        // Decoding refuses to decompress more than this, so that crafted images cannot exhaust memory
+        if (inputText.length() > capacity * maxDecompressionRatio) {
+            std::cerr << "Error: The text is " << inputText.length() << " bytes, but at most " << capacity * maxDecompressionRatio << " bytes can be compressed into this image" << std::endl;
+            exit(-1);
+        }
+        inputText = compressPayload(inputText, compression, threads);
+    }
+
+    std::string nonce(enc->nonceSize(), '\0');
+    std::random_device device;
+    for (char& byte : nonce) byte = static_cast<char>(device());
+    const std::shared_ptr<const KeySchedule> schedule = enc->prepare(key, nonce);
+
+    // The header and nonce are embedded as they are, followed by the text, which is base64 encoded and encoded a block
+    // at a time as it is embedded, so the encoded text is never built in full
+    const size_t textLength = raw ? inputText.length() : base64EncodedSize(inputText.length());
+    std::string prefix;
+    if (header) {
+        PayloadHeader payloadHeader;
+        payloadHeader.bitWidth = static_cast<uint8_t>(bitWidth);
+        payloadHeader.encodingId = enc->id();
+        payloadHeader.flags = (raw ? payloadRawFlag : 0) | (compression ? payloadCompressedFlag : 0);
+        payloadHeader.length = nonce.length() + textLength;
+        prefix = packHeader(payloadHeader);
+    }
+    prefix += nonce;
+    const std::unique_ptr<MessageSource> message = makePipeline(std::move(prefix), inputText, raw, enc, *schedule, threads);
+
+    if (message->length() > capacity) {
+        // Truncating the text would leave a header whose length runs past the end of the image
+        if (header) {
+            std::cerr << "Error: The text and header need " << message->length() << " characters, but the image can only hold " << capacity << std::endl;
+            exit(-1);
+        }
+        std::cerr << "Warning: The last " << message->length() - capacity << " characters of text will be truncated!" << std::endl;
+    }
+
+    // Only some formats can store 16-bit channels, and converting them to 8 bits would lose the text
+    const std::string extension = outputImPth.substr(outputImPth.rfind('.') + 1);
+    if (image.depth() == CV_16U && extension != "png" && extension != "tif" && extension != "tiff") {
+        std::cerr << "Error: 16-bit images can only be written as png or tiff files" << std::endl;
+        exit(-1);
+    }
+
+    // Encode the text into the image in place, since the input image is not needed afterward
+    encodeMessage(image, *message, bitWidth, threads, std::random_device{}(), noiseLength);
     // Write the image
-    imwrite(outputImPth, outputImage);
+    imwrite(outputImPth, image);
+}
+
+
+/**
+ * Reads the payload header from the first pixels of the image, checking that it matches the given bit width and encoding
+ * @param image The image to read the header from
+ * @param bitWidth The number of bits to use for decoding within each channel
+ * @param enc The encoding to use
+ * @param header The header to read into
+ * @return True if the image has a header, false if it was encoded without one
+ */
+bool readHeader(cv::Mat& image, const int bitWidth, const Encoding* enc, PayloadHeader& header) {
+    if (!unpackHeader(decodeChars(image, bitWidth, 0, payloadHeaderSize), header)) {
+        // A header read with the wrong bit width is garbage, so check whether another bit width finds one
+        for (const int otherWidth : supportedBitWidths()) {
+            if (otherWidth != bitWidth && unpackHeader(decodeChars(image, otherWidth, 0, payloadHeaderSize), header)) {
+                std::cerr << "Error: Image was encoded with a bit width of " << otherWidth << ", not " << bitWidth << std::endl;
+                exit(-1);
+            }
+        }
+        return false;
+    }
+
+    if (header.version > payloadHeaderVersion || (header.flags & ~payloadKnownFlags) != 0) {
+        std::cerr << "Error: Image was encoded with a newer version of icrypt (header version " << static_cast<int>(header.version) << ")" << std::endl;
+        exit(-1);
+    }
+    if (header.bitWidth != bitWidth || header.length > textCapacity(image, bitWidth) - payloadHeaderSize ||
+        header.length < enc->nonceSize()) {
+        std::cerr << "Error: Image has a corrupt payload header" << std::endl;
+        exit(-1);
+    }
+    if (header.encodingId != enc->id()) {
+        std::cerr << "Error: Image was not encoded with the '" << enc->name() << "' encoding" << std::endl;
+        exit(-1);
+    }
+    return true;
 }
 
 
@@ -71,21 +176,54 @@ void encodeCommand(const std::string& inputText, const cv::Mat& image, const std
  * Decodes the text from the image
  * @param image The image to decode the text from
  * @param outputTxtPth The path to write the output text to.  If empty, the text will be printed to the console
- * @param bitWidth The number of bits to use for decoding within each channel (1, 2, or 4)
+ * @param bitWidth The number of bits to use for decoding within each channel
  * @param enc The encoding to use
  * @param key The key to decode with
+ * @param threads The number of threads to extract, decode, and base64 decode with, or 0 to use all available threads
  */
-void decodeCommand(cv::Mat& image, const std::string& outputTxtPth, const int bitWidth, Encoding* enc, const std::string& key) {
-    // Decode the text from the image
-    std::string hashEncText = decodeText(image, bitWidth);
-    std::string b64Text = enc->decode(hashEncText, key);
-    std::string plainText = base64Decode(b64Text);
+void decodeCommand(cv::Mat& image, const std::string& outputTxtPth, const int bitWidth, const Encoding* enc, const std::string& key, const int threads) {
+    // Decode exactly the payload if the image has a header, otherwise search for the end of the text
+    PayloadHeader header;
+    const bool hasHeader = readHeader(image, bitWidth, enc, header);
+    if (!hasHeader && enc->requiresHeader()) {
+        std::cerr << "Error: Image has no payload header, so it was not encoded with the '" << enc->name() << "' encoding" << std::endl;
+        exit(-1);
+    }
+    std::string hashEncText = hasHeader ? decodeChars(image, bitWidth, payloadHeaderSize, header.length, threads)
+                                        : decodeText(image, bitWidth, threads);
+
+    // The nonce comes before the text
+    const std::shared_ptr<const KeySchedule> schedule = enc->prepare(key, hashEncText.substr(0, enc->nonceSize()));
+    hashEncText.erase(0, enc->nonceSize());
+
+    // Decode the text where it lies.  Raw payloads are then written out exactly, while text is decoded from base64 and
+    // ends with a newline on the console
+    const bool raw = header.flags & payloadRawFlag;
+    std::string plainText;
+    if (raw) {
+        enc->decodeBytes(hashEncText.data(), hashEncText.length(), *schedule, threads);
+        plainText.swap(hashEncText);
+    } else {
+        enc->decode(hashEncText.data(), hashEncText.length(), *schedule, threads);
+        plainText.resize(base64DecodedSize(hashEncText.length()));
+        plainText.resize(base64Decode(hashEncText, plainText.data(), threads));
+        std::string().swap(hashEncText);  // Free the encoded text, which is no longer needed
+    }
+
+    if (header.flags & payloadCompressedFlag) {
+        const std::string compressed = std::move(plainText);
+        if (!decompressPayload(compressed, plainText, textCapacity(image, bitWidth) * maxDecompressionRatio)) {
+            std::cerr << "Error: Could not decompress the text.  Check that the key is correct" << std::endl;
+            exit(-1);
+        }
+    }
 
     if (!outputTxtPth.empty()) {
-        std::ofstream outTxtFile = std::ofstream(outputTxtPth);
+        std::ofstream outTxtFile = std::ofstream(outputTxtPth, std::ios::binary);
         outTxtFile << plainText;
         outTxtFile.close();
-    } else std::cout << plainText << std::endl;
+    } else if (raw) std::cout << plainText << std::flush;
+    else std::cout << plainText << std::endl;
 }
 
 
@@ -100,17 +238,29 @@ int main(const int argc, char** argv) {
     int bitWidth = 1;
     std::string encoding = "plain";
     std::string keyPth;
+    std::string keystreamCache;
+    int threads = 1;
+    bool header = false;
+    bool raw = false;
+    int compression = 0;
+    size_t disguise = 0;
 
 
-    app.add_option("-e, --encoding", encoding, "The encoding to use (plain, shiftall, shiftchar)")->default_val("plain");
+    app.add_option("-e, --encoding", encoding, "The encoding to use (plain, shiftall, shiftchar, aesctr, hashchar)")->default_val("plain");
     app.add_option("-k, --key", keyPth, "The key file to use for encoding/decoding, if applicable")->default_val("");
-    app.add_option("-b, --bit-width", bitWidth, "The number of bits to use for encoding within each channel (1, 2, or 4)")->default_val(1);
+    app.add_option("-b, --bit-width", bitWidth, "The number of bits to use for encoding within each channel (1, 2, 3, 4, 6, or 8)")->default_val(1);
+    app.add_option("--keystream-cache", keystreamCache, "A directory to cache shiftchar keystreams in, so that encoding or decoding with the same key again skips generating them")->default_val("");
+    app.add_option("-t, --threads", threads, "The number of threads to use for base64 coding, encodings, embedding, and extraction (0 to use all available threads)")->default_val(1);
 
     CLI::App* encode = app.add_subcommand("encode", "Encode text into an image");
     encode->fallthrough();
     encode->add_option("input-image", inputImPth, "The input image to encode the text into")->required();
     encode->add_option("text-file", txtPth, "The text file to encode.  If omitted, text will be read from stdin")->default_val("");
     encode->add_option("-o,--output-image", outputImPth, "The output image to write the text to")->required();
+    CLI::Option* disguiseOpt = encode->add_option("--disguise", disguise, "Only add this many characters of noise after the text, leaving the rest of the image untouched.  If omitted, noise fills the whole image");
+    encode->add_flag("--raw", raw, "Embed the exact bytes of the input file instead of base64 encoding it as text, which also writes a header");
+    encode->add_option("-z,--compress", compression, "Compress the text before embedding it, from 1 (fastest) to 9 (smallest), which also writes a header")->check(CLI::Range(fastestCompression, smallestCompression));
+    encode->add_flag("--header", header, "Write a header before the text so that decoding reads exactly the text instead of searching for its end");
 
     CLI::App* decode = app.add_subcommand("decode", "Decode text from an image");
     decode->fallthrough();
@@ -127,8 +277,14 @@ int main(const int argc, char** argv) {
         return app.exit(cli);
     }
 
-    if (bitWidth != 1 && bitWidth != 2 && bitWidth != 4) {
-        std::cerr << "Error: Bit width must be 1, 2, or 4" << std::endl;
+    if (!isSupportedBitWidth(bitWidth)) {
+        std::cerr << "Error: Bit width must be one of";
+        for (const int supported : supportedBitWidths()) std::cerr << " " << supported;
+        std::cerr << std::endl;
+        return -1;
+    }
+    if (threads < 0) {
+        std::cerr << "Error: Thread count cannot be negative" << std::endl;
         return -1;
     }
     if (encode->parsed() && outputImPth.find('.') == std::string::npos) {
@@ -143,7 +299,8 @@ int main(const int argc, char** argv) {
         return -1;
     }
 
-    Encoding* enc = encodingFromName(encoding);
+    const Encoding* enc = encodingFromName(encoding);
+    setKeystreamCacheDirectory(keystreamCache);
 
     // Read in input image
     cv::Mat image = imread(inputImPth, cv::IMREAD_UNCHANGED);
@@ -153,11 +310,10 @@ int main(const int argc, char** argv) {
     }
 
     if (encode->parsed()) {
-        const std::string inputText = !txtPth.empty() ? textFromFile(txtPth) : textFromStdin();
-        encodeCommand(inputText, image, outputImPth, bitWidth, enc, key);
-    } else decodeCommand(image, txtPth, bitWidth, enc, key);
-
-    delete enc;  // Clean up encoding object
+        std::string inputText = raw ? bytesFromFile(txtPth) : !txtPth.empty() ? textFromFile(txtPth) : textFromStdin();
+        const size_t noiseLength = disguiseOpt->count() ? disguise : std::numeric_limits<size_t>::max();
+        encodeCommand(std::move(inputText), image, outputImPth, bitWidth, enc, key, threads, header, noiseLength, raw, compression);
+    } else decodeCommand(image, txtPth, bitWidth, enc, key, threads);
 
     return 0;
 }
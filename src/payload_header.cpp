@@ -0,0 +1,43 @@
+//
+// Created by matthew on 2/12/25.
+//
+
+#include "payload_header.h"
+
+
+/**
+ * Marks the start of a payload header.  The first character is outside the 7-bit range that base64 text, with or without
+ * an encoding applied, stays within, so it never appears at the start of an image without a header
+ */
+static constexpr char headerMagic[] = {'\x89', 'I', 'C', 'R'};
+
+
+std::string packHeader(const PayloadHeader& header) {
+
+    std::string packed(headerMagic, sizeof(headerMagic));
+    packed += static_cast<char>(header.version);
+    packed += static_cast<char>(header.bitWidth);
+    packed += static_cast<char>(header.encodingId);
+    packed += static_cast<char>(header.flags);
+    for (int i = 0; i < 8; i++)  // Little-endian length
+        packed += static_cast<char>(header.length >> (i * 8) & 0xFF);
+
+    return packed;
+}
+
+
+bool unpackHeader(const std::string& packed, PayloadHeader& header) {
+
+    if (packed.length() < payloadHeaderSize || packed.compare(0, sizeof(headerMagic), headerMagic, sizeof(headerMagic)) != 0)
+        return false;
+
+    header.version = static_cast<uint8_t>(packed[4]);
+    header.bitWidth = static_cast<uint8_t>(packed[5]);
+    header.encodingId = static_cast<uint8_t>(packed[6]);
+    header.flags = static_cast<uint8_t>(packed[7]);
+    header.length = 0;
+    for (int i = 0; i < 8; i++)
+        header.length |= static_cast<uint64_t>(static_cast<uint8_t>(packed[8 + i])) << (i * 8);
+
+    return true;
+}
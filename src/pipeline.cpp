@@ -0,0 +1,111 @@
+//
+// Created by matthew on 3/23/25.
+//
+
+#include <stdexcept>
+#include <type_traits>
+
+#include "base64.h"
+#include "keystream_cache.h"
+#include "pipeline.h"
+
+
+size_t Base64Stage::length(const size_t inputLength) { return base64EncodedSize(inputLength); }
+
+
+void Base64Stage::produce(const std::string_view input, size_t index, size_t count, char* out) {
+    char group[4];
+
+    // Finish the group that the run starts partway through
+    if (const size_t skip = index % 4) {
+        base64Encode(input.substr(index / 4 * 3, 3), group);
+        const size_t groupCount = std::min(4 - skip, count);
+        std::copy_n(group + skip, groupCount, out);
+        out += groupCount;
+        index += groupCount;
+        count -= groupCount;
+    }
+
+    // Encode whole groups straight into the output
+    if (const size_t groups = count / 4) {
+        base64Encode(input.substr(index / 4 * 3, groups * 3), out);
+        out += groups * 4;
+        index += groups * 4;
+        count -= groups * 4;
+    }
+
+    // Start the group that the run ends partway through
+    if (count > 0) {
+        base64Encode(input.substr(index / 4 * 3, 3), group);
+        std::copy_n(group, count, out);
+    }
+}
+
+
+/**
+ * A message that is built in full before it is embedded
+ */
+class StoredMessage final : public MessageSource {
+
+    std::string message;
+
+public:
+
+    explicit StoredMessage(std::string message) : message(std::move(message)) {}
+
+    size_t length() const override { return message.length(); }
+
+    const char* chars(const size_t index, size_t, char*) const override { return message.data() + index; }
+};
+
+
+/**
+ * Creates the pipeline for an encoding whose type is known
+ * @tparam Enc The type of the encoding
+ * @param prefix The characters to embed before the payload
+ * @param input The input to produce the payload from
+ * @param raw Whether to embed the exact bytes of the input instead of base64 encoding it
+ * @param enc The encoding
+ * @param schedule The key schedule to encode with
+ * @return The pipeline
+ */
+template<typename Enc>
+static std::unique_ptr<MessageSource> makePipelineFor(std::string prefix, const std::string_view input, const bool raw,
+                                                      const Enc& enc, const KeySchedule& schedule) {
+    // The plain encoding changes nothing, so it is left out of the pipeline entirely
+    if constexpr (std::is_same_v<Enc, PlainEncoding>) {
+        if (raw) return std::make_unique<Pipeline<RawStage>>(std::move(prefix), input);
+        return std::make_unique<Pipeline<Base64Stage>>(std::move(prefix), input);
+    } else {
+        if (raw) {
+            return std::make_unique<Pipeline<RawStage, EncodeStage<Enc, true>>>(
+                std::move(prefix), input, EncodeStage<Enc, true>{enc, schedule});
+        }
+        return std::make_unique<Pipeline<Base64Stage, EncodeStage<Enc, false>>>(
+            std::move(prefix), input, EncodeStage<Enc, false>{enc, schedule});
+    }
+}
+
+
+std::unique_ptr<MessageSource> makePipeline(std::string prefix, const std::string_view input, const bool raw,
+                                            const Encoding* enc, const KeySchedule& schedule, const int threads) {
+    // Cached shiftchar keystreams are read for a whole text at once, so the payload is encoded in full up front
+    if (dynamic_cast<const ShiftCharEncoding*>(enc) && !keystreamCacheDirectory().empty()) {
+        std::string payload = raw ? std::string(input) : base64Encode(input, threads);
+        if (raw) enc->encodeBytes(payload.data(), payload.length(), schedule, threads);
+        else enc->encode(payload.data(), payload.length(), schedule, threads);
+        return std::make_unique<StoredMessage>(prefix + payload);
+    }
+
+    if (const auto* plain = dynamic_cast<const PlainEncoding*>(enc))
+        return makePipelineFor(std::move(prefix), input, raw, *plain, schedule);
+    if (const auto* shiftAll = dynamic_cast<const ShiftAllEncoding*>(enc))
+        return makePipelineFor(std::move(prefix), input, raw, *shiftAll, schedule);
+    if (const auto* shiftChar = dynamic_cast<const ShiftCharEncoding*>(enc))
+        return makePipelineFor(std::move(prefix), input, raw, *shiftChar, schedule);
+    if (const auto* aesCtr = dynamic_cast<const AesCtrEncoding*>(enc))
+        return makePipelineFor(std::move(prefix), input, raw, *aesCtr, schedule);
+    if (const auto* hashChar = dynamic_cast<const HashCharEncoding*>(enc))
+        return makePipelineFor(std::move(prefix), input, raw, *hashChar, schedule);
+    throw std::runtime_error("Encoding '" + enc->name() + "' has no pipeline!");
+}
@@ -0,0 +1,90 @@
+//
+// Created by matthew on 3/16/25.
+//
+
+#include "sha256.h"
+
+
+/**
+ * The first 32 bits of the fractional parts of the cube roots of the first 64 primes
+ */
+static constexpr uint32_t roundConstants[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+
+static uint32_t rotateRight(const uint32_t value, const int bits) { return value >> bits | value << (32 - bits); }
+
+
+/**
+ * Mixes one 64-byte block into the hash state
+ * @param state The hash state
+ * @param block The block to mix in
+ */
+static void compress(uint32_t state[8], const uint8_t* block) {
+
+    uint32_t schedule[64];
+    for (int i = 0; i < 16; i++)
+        schedule[i] = uint32_t(block[i * 4]) << 24 | uint32_t(block[i * 4 + 1]) << 16 |
+                      uint32_t(block[i * 4 + 2]) << 8 | uint32_t(block[i * 4 + 3]);
+    for (int i = 16; i < 64; i++) {
+        const uint32_t s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ schedule[i - 15] >> 3;
+        const uint32_t s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ schedule[i - 2] >> 10;
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        const uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) +
+                            roundConstants[i] + schedule[i];
+        const uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+
+std::array<uint8_t, sha256Size> sha256(const std::string_view data) {
+
+    uint32_t state[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    size_t i = 0;
+    for (; i + 64 <= data.length(); i += 64) compress(state, bytes + i);
+
+    // Pad the last block with a single set bit, zeros, and the length in bits, spilling into a second block if needed
+    uint8_t tail[128] = {};
+    const size_t remaining = data.length() - i;
+    for (size_t j = 0; j < remaining; j++) tail[j] = bytes[i + j];
+    tail[remaining] = 0x80;
+    const size_t tailLength = remaining < 56 ? 64 : 128;
+    const uint64_t bits = static_cast<uint64_t>(data.length()) * 8;
+    for (int j = 0; j < 8; j++) tail[tailLength - 1 - j] = static_cast<uint8_t>(bits >> (j * 8));
+    for (size_t j = 0; j < tailLength; j += 64) compress(state, tail + j);
+
+    std::array<uint8_t, sha256Size> digest{};
+    for (int j = 0; j < 8; j++)
+        for (int k = 0; k < 4; k++) digest[j * 4 + k] = static_cast<uint8_t>(state[j] >> (24 - k * 8));
+    return digest;
+}
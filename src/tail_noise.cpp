@@ -0,0 +1,50 @@
+//
+// Created by matthew on 2/9/25.
+//
+
+#include "tail_noise.h"
+
+
+/**
+ * The characters that noise is drawn from, so that it cannot be told apart from base64 text
+ */
+static constexpr char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/**
+ * Gets the random block of 8 noise characters at the given counter.  Uses the SplitMix64 output function on a
+ * counter, which needs no state between blocks and has no dependency between neighbouring blocks
+ * @param seed The seed of the generator
+ * @param counter The index of the block
+ * @return 64 random bits, one byte per character
+ */
+static uint64_t noiseBlock(const uint64_t seed, const uint64_t counter) {
+    uint64_t z = seed + (counter + 1) * 0x9E3779B97F4A7C15;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+
+TailNoise::TailNoise(const uint64_t seed) : seed(seed) {}
+
+
+char TailNoise::at(const size_t index) const {
+    return base64Chars[noiseBlock(seed, index / 8) >> (index % 8 * 8) & 0x3F];
+}
+
+
+void TailNoise::fill(char* chars, size_t index, size_t count) const {
+
+    // Characters before the first whole block
+    for (; count > 0 && index % 8 != 0; count--) *chars++ = at(index++);
+
+    // Whole blocks are independent of each other, so this loop can be unrolled and vectorized
+    for (; count >= 8; count -= 8, index += 8, chars += 8) {
+        const uint64_t block = noiseBlock(seed, index / 8);
+        for (int k = 0; k < 8; k++)
+            chars[k] = base64Chars[block >> (k * 8) & 0x3F];
+    }
+
+    for (; count > 0; count--) *chars++ = at(index++);
+}
@@ -0,0 +1,109 @@
+//
+// Created by matthew on 3/16/25.
+//
+
+#include <random>
+#include <catch2/catch_test_macros.hpp>
+
+#include "aes_ctr.h"
+
+
+/**
+ * Parses lowercase hexadecimal into bytes
+ * @tparam Size The number of bytes to parse
+ * @param hex The hexadecimal to parse
+ * @return The parsed bytes
+ */
+template<size_t Size>
+static std::array<uint8_t, Size> bytesOf(const std::string& hex) {
+    std::array<uint8_t, Size> bytes{};
+    for (size_t i = 0; i < Size; i++) bytes[i] = static_cast<uint8_t>(std::stoi(hex.substr(i * 2, 2), nullptr, 16));
+    return bytes;
+}
+
+
+/**
+ * Parses lowercase hexadecimal into a std::string of bytes
+ * @param hex The hexadecimal to parse
+ * @return The parsed bytes
+ */
+static std::string stringOf(const std::string& hex) {
+    std::string bytes;
+    for (size_t i = 0; i < hex.length(); i += 2) bytes += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+    return bytes;
+}
+
+
+TEST_CASE("Test AES-CTR") {
+
+    for (const bool allowHardware : {true, false}) {
+
+        SECTION("Test Block Cipher " + std::to_string(allowHardware)) {
+            // FIPS 197 appendix C.3
+            const AesCtr aes(bytesOf<aesKeySize>("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"), {},
+                             allowHardware);
+            const std::array<uint8_t, aesBlockSize> plain = bytesOf<aesBlockSize>("00112233445566778899aabbccddeeff");
+            std::array<uint8_t, aesBlockSize> encrypted{};
+            aes.encryptBlock(plain.data(), encrypted.data());
+            REQUIRE( encrypted == bytesOf<aesBlockSize>("8ea2b7ca516745bfeafc49904b496089") );
+        }
+
+        SECTION("Test Counter Mode " + std::to_string(allowHardware)) {
+            // NIST SP 800-38A F.5.5
+            const AesCtr aes(bytesOf<aesKeySize>("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4"),
+                             bytesOf<aesBlockSize>("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"), allowHardware);
+            const std::string plain = stringOf("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                               "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+            const std::string cipher = stringOf("601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c5"
+                                                "2b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6");
+
+            std::string text = plain;
+            aes.apply(text.data(), text.length());
+            REQUIRE( text == cipher );
+            aes.apply(text.data(), text.length());
+            REQUIRE( text == plain );
+
+            // Any range of the keystream can be applied on its own
+            for (size_t begin = 0; begin < plain.length(); begin += 7) {
+                std::string piece = plain.substr(begin, 13);
+                aes.apply(piece.data(), piece.length(), begin);
+                REQUIRE( piece == cipher.substr(begin, 13) );
+            }
+        }
+    }
+
+    SECTION("Test Hardware Matches Software") {
+        std::mt19937 random(7);
+        std::array<uint8_t, aesKeySize> key{};
+        for (uint8_t& byte : key) byte = static_cast<uint8_t>(random());
+
+        // The low half of the counter overflows partway through the text
+        std::array<uint8_t, aesBlockSize> counter{};
+        counter.fill(0xFF);
+        counter[0] = 0x12;
+        counter[15] = 0xF0;
+
+        const AesCtr hardware(key, counter, true);
+        const AesCtr software(key, counter, false);
+        std::string text(5000, '\0');
+        for (char& chr : text) chr = static_cast<char>(random());
+        for (int i = 0; i < 50; i++) {
+            const size_t position = random() % 1000;
+            const size_t length = random() % 4000;
+            std::string fromHardware = text.substr(0, length);
+            std::string fromSoftware = fromHardware;
+            hardware.apply(fromHardware.data(), length, position);
+            software.apply(fromSoftware.data(), length, position);
+            REQUIRE( fromHardware == fromSoftware );
+        }
+
+        // The carry reaches the high half of the counter
+        std::string whole = text.substr(0, 512);
+        software.apply(whole.data(), whole.length());
+        std::array<uint8_t, aesBlockSize> carried{};
+        carried[0] = 0x13;
+        std::string afterCarry = text.substr(16 * 16, 16);
+        AesCtr(key, carried, false).apply(afterCarry.data(), afterCarry.length());
+        REQUIRE( afterCarry == whole.substr(16 * 16, 16) );
+    }
+}
@@ -55,4 +55,90 @@ TEST_CASE("Test Base64 Decode") {
         REQUIRE( base64Decode("G1Qy/ogQNG9UaQ==") ==
             "\x1B\x54\x32\xFE\x88\x10\x34\x6F\x54\x69" );
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test Base64 Long Strings") {
+    std::string bytes;
+    for (int i = 0; i < 300; i++) bytes += static_cast<char>(i * 37 + 11);
+    const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    SECTION("Test Round Trip") {
+        // Lengths on either side of each block size
+        for (size_t length = 0; length <= bytes.length(); length++) {
+            const std::string encoded = base64Encode(bytes.substr(0, length));
+            REQUIRE( encoded.length() == (length + 2) / 3 * 4 );
+            REQUIRE( base64Decode(encoded) == bytes.substr(0, length) );
+        }
+    }
+
+    SECTION("Test Every Character") {
+        std::string encoded;
+        for (int i = 0; i < 4; i++) encoded += alphabet;
+        REQUIRE( base64Encode(base64Decode(encoded)) == encoded );
+    }
+
+    SECTION("Test Stopping at Invalid Characters") {
+        const std::string encoded = base64Encode(bytes);
+        for (const size_t position : {0, 1, 2, 3, 17, 33, 64, 101, 255}) {
+            for (const char invalid : {'\0', '=', '-', '\xC3'}) {
+                std::string corrupted = encoded;
+                corrupted[position] = invalid;
+                // Everything after the first invalid character is ignored, including a final partial group
+                REQUIRE( base64Decode(corrupted) == bytes.substr(0, position * 3 / 4) );
+            }
+        }
+    }
+}
+
+
+TEST_CASE("Test Base64 Multithreaded") {
+    // Large enough to be split into several chunks
+    std::string bytes(1 << 20, '\0');
+    for (size_t i = 0; i < bytes.length(); i++) bytes[i] = static_cast<char>(i * 131 + (i >> 9));
+
+    for (const size_t length : {bytes.length(), bytes.length() - 1, bytes.length() - 2}) {
+        const std::string serial = base64Encode(bytes.substr(0, length));
+        REQUIRE( base64Encode(bytes.substr(0, length), 4) == serial );
+        REQUIRE( base64Encode(bytes.substr(0, length), 0) == serial );
+        REQUIRE( base64Decode(serial, 4) == base64Decode(serial) );
+    }
+
+    SECTION("Test Stopping at Invalid Characters") {
+        const std::string encoded = base64Encode(bytes);
+        for (const size_t position : {encoded.length() / 3 + 5, encoded.length() - 3}) {
+            std::string corrupted = encoded;
+            corrupted[position] = '-';
+            corrupted[position + 1] = '\0';  // Only the first invalid character is considered
+            REQUIRE( base64Decode(corrupted, 3) == bytes.substr(0, position * 3 / 4) );
+        }
+    }
+}
+
+
+TEST_CASE("Test Base64 Buffers") {
+    SECTION("Test Sizes") {
+        REQUIRE( base64EncodedSize(0) == 0 );
+        REQUIRE( base64EncodedSize(1) == 4 );
+        REQUIRE( base64EncodedSize(6) == 8 );
+        REQUIRE( base64EncodedSize(7) == 12 );
+        for (size_t length = 0; length < 20; length++)
+            REQUIRE( base64DecodedSize(base64EncodedSize(length)) >= length );
+        REQUIRE( base64DecodedSize(3) == 2 );  // An unpadded partial group
+    }
+
+    SECTION("Test Reused Buffers") {
+        std::string encoded(base64EncodedSize(64), '\0');
+        std::string decoded(base64DecodedSize(encoded.length()), '\0');
+        for (const std::string_view text : {"hello", "haltingproble", "That's no moon.  It's a space station!"}) {
+            const size_t encodedLength = base64Encode(text, encoded.data());
+            REQUIRE( std::string_view(encoded.data(), encodedLength) == base64Encode(text) );
+            const size_t decodedLength = base64Decode(std::string_view(encoded.data(), encodedLength), decoded.data());
+            REQUIRE( std::string_view(decoded.data(), decodedLength) == text );
+        }
+    }
+
+    SECTION("Test Unpadded Partial Groups") {
+        REQUIRE( base64Decode("aGVsbG8") == "hello" );
+        REQUIRE( base64Decode("aGFsdGluZ3Byb2JsZQ") == "haltingproble" );
+    }
+}
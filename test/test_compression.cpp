@@ -0,0 +1,89 @@
+//
+// Created by matthew on 3/2/25.
+//
+
+#include <cstdint>
+#include <catch2/catch_test_macros.hpp>
+#include <zlib.h>
+
+#include "compression.h"
+
+
+TEST_CASE("Test Compression") {
+    std::string text;
+    for (int i = 0; i < 1000; i++) text += "{\"line\": " + std::to_string(i) + ", \"text\": \"hello there\"}\n";
+
+    SECTION("Test Round Trip") {
+        for (int level = fastestCompression; level <= smallestCompression; level++) {
+            const std::string compressed = compressPayload(text, level);
+            REQUIRE( compressed.length() * 3 < text.length() );
+
+            std::string decompressed;
+            REQUIRE( decompressPayload(compressed, decompressed, SIZE_MAX) );
+            REQUIRE( decompressed == text );
+        }
+    }
+
+    SECTION("Test Binary") {
+        std::string bytes;
+        for (int i = 0; i < 256; i++) bytes += static_cast<char>(i);
+
+        std::string decompressed;
+        REQUIRE( decompressPayload(compressPayload(bytes, fastestCompression), decompressed, SIZE_MAX) );
+        REQUIRE( decompressed == bytes );
+        REQUIRE( decompressPayload(compressPayload("", fastestCompression), decompressed, SIZE_MAX) );
+        REQUIRE( decompressed.empty() );
+    }
+
+    SECTION("Test Corrupt") {
+        const std::string compressed = compressPayload(text, smallestCompression);
+
+        std::string decompressed;
+        REQUIRE_FALSE( decompressPayload(compressed.substr(0, compressed.length() / 2), decompressed, SIZE_MAX) );
+        REQUIRE_FALSE( decompressPayload("not compressed", decompressed, SIZE_MAX) );
+
+        std::string flipped = compressed;
+        flipped[flipped.length() / 2] ^= 0x55;
+        REQUIRE_FALSE( decompressPayload(flipped, decompressed, SIZE_MAX) );
+    }
+
+    SECTION("Test Longest Payload") {
+        // A payload of zeros expands about a thousand times over
+        const std::string zeros(1 << 22, '\0');
+        const std::string compressed = compressPayload(zeros, smallestCompression);
+        REQUIRE( compressed.length() * 500 < zeros.length() );
+
+        std::string decompressed;
+        REQUIRE( decompressPayload(compressed, decompressed, zeros.length()) );
+        REQUIRE( decompressed == zeros );
+        REQUIRE_FALSE( decompressPayload(compressed, decompressed, zeros.length() - 1) );
+        REQUIRE_FALSE( decompressPayload(compressed, decompressed, 1000) );
+        REQUIRE( decompressed.length() < 1000 + (1 << 16) );
+    }
+
+    SECTION("Test Same As compress2") {
+        // Payloads that fit in a single segment compress exactly as zlib compresses them
+        for (int level = fastestCompression; level <= smallestCompression; level++) {
+            std::string expected(compressBound(text.length()), '\0');
+            uLongf expectedLength = expected.length();
+            compress2(reinterpret_cast<Bytef*>(expected.data()), &expectedLength,
+                      reinterpret_cast<const Bytef*>(text.data()), text.length(), level);
+            expected.resize(expectedLength);
+            REQUIRE( compressPayload(text, level) == expected );
+        }
+    }
+
+    SECTION("Test Multithreaded") {
+        // Several segments, the last of them partial, which all refer back into the segments before them
+        std::string large;
+        while (large.length() < 3500000) large += text + std::to_string(large.length());
+
+        const std::string compressed = compressPayload(large, 6);
+        REQUIRE( compressed.length() * 3 < large.length() );
+        for (const int threads : {2, 3, 0}) REQUIRE( compressPayload(large, 6, threads) == compressed );
+
+        std::string decompressed;
+        REQUIRE( decompressPayload(compressed, decompressed, SIZE_MAX) );
+        REQUIRE( decompressed == large );
+    }
+}
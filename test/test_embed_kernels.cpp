@@ -0,0 +1,138 @@
+//
+// Created by matthew on 2/3/25.
+//
+
+#include <random>
+#include <catch2/catch_test_macros.hpp>
+
+#include "embed_kernels.h"
+
+
+/**
+ * Runs a check against every supported kernel set over random inputs of various lengths
+ * @param check Called with the scalar kernels, the kernels to compare, random characters, and random channels
+ */
+template<typename Check>
+void forEachKernelSet(Check check) {
+    const std::vector<const EmbedKernels*> kernels = availableEmbedKernels();
+    std::mt19937 rng(1234);
+
+    for (const EmbedKernels* simd : kernels) {
+        for (const size_t count : {0, 1, 3, 15, 16, 17, 31, 32, 33, 100, 1027}) {
+            std::string chars(count, '\0');
+            std::vector<uchar> channels(count * 8);
+            for (char& c : chars) c = static_cast<char>(rng());
+            for (uchar& c : channels) c = static_cast<uchar>(rng());
+            check(*kernels.front(), *simd, chars, channels);
+        }
+    }
+}
+
+
+TEST_CASE("Test Kernels Match Scalar") {
+    REQUIRE( std::string(availableEmbedKernels().front()->name) == "scalar" );
+
+    SECTION("Grounding") {
+        forEachKernelSet([](const EmbedKernels& scalar, const EmbedKernels& simd, const std::string&, const std::vector<uchar>& channels) {
+            for (const uchar mask : {0xFE, 0xFC, 0xF0}) {
+                std::vector<uchar> expected = channels, actual = channels;
+                scalar.ground(expected.data(), expected.size(), mask);
+                simd.ground(actual.data(), actual.size(), mask);
+                REQUIRE( expected == actual );
+            }
+        });
+    }
+
+    SECTION("Embedding") {
+        forEachKernelSet([](const EmbedKernels& scalar, const EmbedKernels& simd, const std::string& chars, const std::vector<uchar>& channels) {
+            const std::pair<EmbedKernel, EmbedKernel> pairs[] = {
+                {scalar.embed1, simd.embed1}, {scalar.embed2, simd.embed2}, {scalar.embed4, simd.embed4}
+            };
+            for (const auto& [expectedKernel, actualKernel] : pairs) {
+                std::vector<uchar> expected = channels, actual = channels;
+                expectedKernel(expected.data(), chars.data(), chars.size());
+                actualKernel(actual.data(), chars.data(), chars.size());
+                REQUIRE( expected == actual );
+            }
+        });
+    }
+
+    SECTION("Extracting") {
+        forEachKernelSet([](const EmbedKernels& scalar, const EmbedKernels& simd, const std::string& chars, const std::vector<uchar>& channels) {
+            const std::pair<ExtractKernel, ExtractKernel> pairs[] = {
+                {scalar.extract1, simd.extract1}, {scalar.extract2, simd.extract2}, {scalar.extract4, simd.extract4}
+            };
+            for (const auto& [expectedKernel, actualKernel] : pairs) {
+                std::string expected(chars.size(), '\0'), actual(chars.size(), '\0');
+                expectedKernel(channels.data(), expected.data(), chars.size());
+                actualKernel(channels.data(), actual.data(), chars.size());
+                REQUIRE( expected == actual );
+            }
+        });
+    }
+}
+
+
+TEST_CASE("Test Scalar Kernels Round Trip") {
+    const EmbedKernels& scalar = *availableEmbedKernels().front();
+    const std::string text = "Round trip!";
+
+    const std::pair<EmbedKernel, ExtractKernel> pairs[] = {
+        {scalar.embed1, scalar.extract1}, {scalar.embed2, scalar.extract2}, {scalar.embed4, scalar.extract4}
+    };
+    for (const auto& [embed, extract] : pairs) {
+        std::vector<uchar> channels(text.size() * 8, 0);
+        std::string decoded(text.size(), '\0');
+        embed(channels.data(), text.data(), text.size());
+        extract(channels.data(), decoded.data(), text.size());
+        REQUIRE( decoded == text );
+    }
+}
+
+
+TEST_CASE("Test Generic Kernels") {
+    const EmbedKernels& scalar = *availableEmbedKernels().front();
+
+    SECTION("Matching Scalar") {
+        forEachKernelSet([&](const EmbedKernels&, const EmbedKernels&, const std::string& chars, const std::vector<uchar>& channels) {
+            const std::pair<EmbedKernel, EmbedKernel> embeds[] = {
+                {scalar.embed1, embedGeneric<1, uchar>}, {scalar.embed2, embedGeneric<2, uchar>}, {scalar.embed4, embedGeneric<4, uchar>}
+            };
+            for (const auto& [expectedKernel, actualKernel] : embeds) {
+                std::vector<uchar> expected = channels, actual = channels;
+                expectedKernel(expected.data(), chars.data(), chars.size());
+                actualKernel(actual.data(), chars.data(), chars.size());
+                REQUIRE( expected == actual );
+            }
+
+            const std::pair<ExtractKernel, ExtractKernel> extracts[] = {
+                {scalar.extract1, extractGeneric<1, uchar>}, {scalar.extract2, extractGeneric<2, uchar>}, {scalar.extract4, extractGeneric<4, uchar>}
+            };
+            for (const auto& [expectedKernel, actualKernel] : extracts) {
+                std::string expected(chars.size(), '\0'), actual(chars.size(), '\0');
+                expectedKernel(channels.data(), expected.data(), chars.size());
+                actualKernel(channels.data(), actual.data(), chars.size());
+                REQUIRE( expected == actual );
+            }
+        });
+    }
+
+    SECTION("16-Bit Round Trip") {
+        const std::string text = "Wide channels!";  // A multiple of 3 characters long for the packed bit widths
+        const auto roundTrip = [&](auto embed, auto extract, const ushort mask) {
+            std::vector<ushort> channels(text.size() * 8, 0xABCD);
+            std::string decoded(text.size(), '\0');
+            groundGeneric<ushort>(channels.data(), channels.size(), mask);
+            embed(channels.data(), text.data(), text.size());
+            extract(channels.data(), decoded.data(), text.size());
+            REQUIRE( decoded == text );
+            for (const ushort channel : channels) REQUIRE( (channel & mask) == (0xABCD & mask) );
+        };
+        roundTrip(embedGeneric<1, ushort>, extractGeneric<1, ushort>, 0xFFFE);
+        roundTrip(embedGeneric<2, ushort>, extractGeneric<2, ushort>, 0xFFFC);
+        roundTrip(embedGeneric<3, ushort>, extractGeneric<3, ushort>, 0xFFF8);
+        roundTrip(embedGeneric<4, ushort>, extractGeneric<4, ushort>, 0xFFF0);
+        roundTrip(embedGeneric<6, ushort>, extractGeneric<6, ushort>, 0xFFC0);
+        roundTrip(embedGeneric<8, ushort>, extractGeneric<8, ushort>, 0xFF00);
+    }
+}
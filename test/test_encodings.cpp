@@ -5,20 +5,90 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include "base64.h"
 #include "encodings.h"
+#include "image_encode.h"
+#include "payload_header.h"
+#include "sha256.h"
 
 
 TEST_CASE("Test Get Encoding from Name") {
     REQUIRE( encodingFromName("plain")->name() == "plain" );
     REQUIRE( encodingFromName("shiftall")->name() == "shiftall" );
     REQUIRE( encodingFromName("shiftchar")->name() == "shiftchar" );
+    REQUIRE( encodingFromName("aesctr")->name() == "aesctr" );
+    REQUIRE( encodingFromName("hashchar")->name() == "hashchar" );
 
     REQUIRE_THROWS_AS( encodingFromName("notanencoding"), std::runtime_error );
+
+    // Every lookup returns the same shared instance
+    REQUIRE( encodingFromName("shiftchar") == encodingFromName("shiftchar") );
+}
+
+
+TEST_CASE("Test Key Schedules") {
+    for (const std::string name : {"plain", "shiftall", "shiftchar", "aesctr", "hashchar"}) {
+        const Encoding* enc = encodingFromName(name);
+        const std::shared_ptr<const KeySchedule> schedule = enc->prepare("42");
+
+        // A schedule can be reused for any number of texts and encodes the same as the key it was prepared from
+        for (const std::string text : {"", "hello there", "general kenobi"}) {
+            REQUIRE( enc->encode(text, *schedule) == enc->encode(text, "42") );
+            REQUIRE( enc->decode(enc->encode(text, *schedule), *schedule) == text );
+            REQUIRE( enc->decodeBytes(enc->encodeBytes(text, *schedule), *schedule) == text );
+        }
+    }
+
+    // A schedule only belongs to the encoding that prepared it
+    const std::shared_ptr<const KeySchedule> shiftAllSchedule = encodingFromName("shiftall")->prepare("42");
+    REQUIRE_THROWS_AS( encodingFromName("shiftchar")->encode("hello there", *shiftAllSchedule), std::runtime_error );
+}
+
+
+TEST_CASE("Test In Place") {
+    for (const std::string name : {"plain", "shiftall", "shiftchar", "aesctr", "hashchar"}) {
+        const Encoding* enc = encodingFromName(name);
+        const std::shared_ptr<const KeySchedule> schedule = enc->prepare("42");
+
+        // Transforming a buffer in place matches the string versions and leaves the rest of the buffer alone
+        std::string buffer = "[hello there]";
+        enc->encode(buffer.data() + 1, buffer.length() - 2, *schedule);
+        REQUIRE( buffer == "[" + enc->encode("hello there", *schedule) + "]" );
+        enc->decode(buffer.data() + 1, buffer.length() - 2, *schedule);
+        REQUIRE( buffer == "[hello there]" );
+
+        enc->encodeBytes(buffer.data() + 1, buffer.length() - 2, *schedule);
+        REQUIRE( buffer == "[" + enc->encodeBytes("hello there", *schedule) + "]" );
+        enc->decodeBytes(buffer.data() + 1, buffer.length() - 2, *schedule);
+        REQUIRE( buffer == "[hello there]" );
+    }
+}
+
+
+TEST_CASE("Test Encode At") {
+    std::string text;
+    for (int i = 0; i < 10007; i++) text += static_cast<char>(i * 37 % 127 + 1);
+
+    for (const std::string name : {"plain", "shiftall", "shiftchar", "aesctr", "hashchar"}) {
+        const Encoding* enc = encodingFromName(name);
+        const std::shared_ptr<const KeySchedule> schedule = enc->prepare("42");
+
+        // Encoding a text in uneven pieces at their positions matches encoding it whole
+        std::string pieces = text;
+        std::string bytePieces = text;
+        for (size_t begin = 0, size = 1; begin < text.length(); begin += size, size = size * 3 + 1) {
+            const size_t length = std::min(size, text.length() - begin);
+            enc->encodeAt(pieces.data() + begin, length, begin, *schedule);
+            enc->encodeBytesAt(bytePieces.data() + begin, length, begin, *schedule);
+        }
+        REQUIRE( pieces == enc->encode(text, *schedule) );
+        REQUIRE( bytePieces == enc->encodeBytes(text, *schedule) );
+    }
 }
 
 
 TEST_CASE("Test Plain") {
-    Encoding* enc = encodingFromName("plain");
+    const Encoding* enc = encodingFromName("plain");
 
     SECTION("Test Encoding") {
         REQUIRE( enc->encode("", "42").empty() );
@@ -34,7 +104,7 @@ TEST_CASE("Test Plain") {
 
 
 TEST_CASE("Test ShiftAll") {
-    Encoding* enc = encodingFromName("shiftall");
+    const Encoding* enc = encodingFromName("shiftall");
 
     SECTION("Test Encoding") {
         REQUIRE( enc->encode("", "42").empty() );
@@ -46,11 +116,34 @@ TEST_CASE("Test ShiftAll") {
         REQUIRE( enc->decode("\x19\x16\x1D\x1D Q%\x19\x16#\x16", "42") == "hello there" );
         REQUIRE_FALSE( enc->decode("\x19\x16\x1D\x1D Q%\x19\x16#\x16", "bad") == "hello there" );
     }
+
+    SECTION("Test Every Character") {
+        // Every byte value, repeated so that the vectorized kernels and their scalar tails are both used
+        std::string text;
+        for (int repeat = 0; repeat < 3; repeat++)
+            for (int i = 0; i < 256; i++) text += static_cast<char>(i);
+        text += "tail";
+
+        for (int k = 0; k < 200; k++) {
+            const std::string key = std::to_string(k);
+            const int keyHash = abs(static_cast<int>(std::hash<std::string>{}(key)) % 128);
+
+            std::string expectedEncoded;
+            std::string expectedDecoded;
+            for (const char chr : text) {
+                expectedEncoded += static_cast<char>(chr + keyHash < 128 ? chr + keyHash : chr + keyHash - 128);
+                expectedDecoded += static_cast<char>(chr - keyHash > 0 ? chr - keyHash : chr - keyHash + 128);
+            }
+
+            REQUIRE( enc->encode(text, key) == expectedEncoded );
+            REQUIRE( enc->decode(text, key) == expectedDecoded );
+        }
+    }
 }
 
 
 TEST_CASE("Test ShiftChar") {
-    Encoding* enc = encodingFromName("shiftchar");
+    const Encoding* enc = encodingFromName("shiftchar");
 
     SECTION("Test Encoding") {
         REQUIRE( enc->encode("", "42").empty() );
@@ -62,4 +155,186 @@ TEST_CASE("Test ShiftChar") {
         REQUIRE( enc->decode("\024(\035>>\vU\031k=L", "42") == "hello there" );
         REQUIRE_FALSE( enc->decode("\024(\035>>\vU\031k=L", "bad") == "hello there" );
     }
-}
\ No newline at end of file
+
+    SECTION("Test Long Text") {
+        // Long enough to carry the index through several digits and past a block of the keystream
+        std::string text;
+        for (int i = 0; i < 10007; i++) text += static_cast<char>(i * 37 % 256);
+
+        for (const std::string key : {"", "4", "a longer key"}) {
+            std::string expectedEncoded;
+            std::string expectedDecoded;
+            for (size_t i = 0; i < text.length(); i++) {
+                const std::string charKey = (!key.empty() ? key.substr(i % key.length(), 1) : "") + std::to_string(i);
+                const int keyHash = abs(static_cast<int>(std::hash<std::string>{}(charKey)) % 128);
+                const int chr = text[i];
+                expectedEncoded += static_cast<char>(chr + keyHash < 128 ? chr + keyHash : chr + keyHash - 128);
+                expectedDecoded += static_cast<char>(chr - keyHash > 0 ? chr - keyHash : chr - keyHash + 128);
+            }
+
+            REQUIRE( enc->encode(text, key) == expectedEncoded );
+            REQUIRE( enc->decode(text, key) == expectedDecoded );
+            REQUIRE( enc->decodeBytes(enc->encodeBytes(text, key), key) == text );
+        }
+    }
+}
+
+TEST_CASE("Test HashChar") {
+    const Encoding* enc = encodingFromName("hashchar");
+
+    SECTION("Test Encoding") {
+        REQUIRE( enc->encode("", "42").empty() );
+        REQUIRE( enc->encode("hello there", "42") == "()v(Cb\016r;\033_" );
+    }
+
+    SECTION("Test Decoding") {
+        REQUIRE( enc->decode("", "42").empty() );
+        REQUIRE( enc->decode("()v(Cb\016r;\033_", "42") == "hello there" );
+        REQUIRE_FALSE( enc->decode("()v(Cb\016r;\033_", "bad") == "hello there" );
+    }
+
+    SECTION("Test Long Text") {
+        // Long enough to span several blocks of the keystream and end partway through a hash.  Shifting down never gives
+        // back a null character, so the text has none
+        std::string text;
+        for (int i = 0; i < 10007; i++) text += static_cast<char>(i * 37 % 127 + 1);
+
+        const auto mix = [](uint32_t x) {
+            x ^= x >> 16;
+            x *= 0x7FEB352D;
+            x ^= x >> 15;
+            x *= 0x846CA68B;
+            return x ^ (x >> 16);
+        };
+        for (const std::string key : {"", "4", "a longer key"}) {
+            const std::array<uint8_t, sha256Size> digest = sha256(key);
+            uint32_t seed[8];
+            for (int lane = 0; lane < 8; lane++)
+                seed[lane] = digest[lane * 4] | digest[lane * 4 + 1] << 8 | digest[lane * 4 + 2] << 16 |
+                             static_cast<uint32_t>(digest[lane * 4 + 3]) << 24;
+
+            std::string expectedEncoded;
+            for (size_t i = 0; i < text.length(); i++) {
+                const int lane = i % 32 / 4;
+                const uint32_t hash = mix(mix(seed[lane] ^ static_cast<uint32_t>(i / 32)) ^ seed[(lane + 4) % 8]);
+                const int shift = static_cast<int>(hash >> (i % 4 * 8) & 127);
+                const int chr = text[i];
+                expectedEncoded += static_cast<char>(chr + shift < 128 ? chr + shift : chr + shift - 128);
+            }
+
+            REQUIRE( enc->encode(text, key) == expectedEncoded );
+            REQUIRE( enc->decode(expectedEncoded, key) == text );
+            REQUIRE( enc->decodeBytes(enc->encodeBytes(text, key), key) == text );
+        }
+    }
+
+    SECTION("Test Image Round Trip") {
+        // Base64 text shifts into null characters for most keys, so searching for the end of the text stops early and
+        // the text only round trips after a header
+        std::string bytes;
+        for (int i = 0; i < 3000; i++) bytes += static_cast<char>(i * 131 % 256);
+        const std::string text = base64Encode(bytes);
+        REQUIRE( enc->requiresHeader() );
+
+        bool truncated = false;
+        for (int k = 0; k < 20; k++) {
+            const std::string key = "key " + std::to_string(k);
+            const std::string encoded = enc->encode(text, key);
+
+            cv::Mat headerless(96, 96, CV_8UC3, cv::Scalar::all(0));
+            encodeText(headerless, encoded, 2);
+            truncated = truncated || decodeText(headerless, 2).length() < encoded.length();
+
+            PayloadHeader header;
+            header.bitWidth = 2;
+            header.encodingId = enc->id();
+            header.length = encoded.length();
+            cv::Mat withHeader(96, 96, CV_8UC3, cv::Scalar::all(0));
+            encodeText(withHeader, packHeader(header) + encoded, 2);
+
+            PayloadHeader decodedHeader;
+            REQUIRE( unpackHeader(decodeChars(withHeader, 2, 0, payloadHeaderSize), decodedHeader) );
+            const std::string decoded = decodeChars(withHeader, 2, payloadHeaderSize, decodedHeader.length);
+            REQUIRE( base64Decode(enc->decode(decoded, key)) == bytes );
+        }
+        REQUIRE( truncated );
+    }
+}
+
+
+TEST_CASE("Test AesCtr") {
+    const Encoding* enc = encodingFromName("aesctr");
+    REQUIRE( enc->nonceSize() == 16 );
+
+    SECTION("Test Encoding") {
+        // The key is the SHA-256 digest of "42", and a missing nonce is all zeros
+        REQUIRE( enc->encode("", "42").empty() );
+        REQUIRE( enc->encode("hello there", "42") == "\x84\xbf\xd1\xc9\xa8\x59\xf7\xaf\x31\xa2\x10" );
+        REQUIRE( enc->encodeBytes("hello there", "42") == enc->encode("hello there", "42") );
+
+        std::string nonce;
+        for (int i = 0; i < 16; i++) nonce += static_cast<char>(i);
+        REQUIRE( enc->encode("hello there", *enc->prepare("42", nonce)) == "\x26\x05\xcf\xf9\x4d\xb7\x56\xba\xbb\x35\x53" );
+    }
+
+    SECTION("Test Decoding") {
+        REQUIRE( enc->decode("\x84\xbf\xd1\xc9\xa8\x59\xf7\xaf\x31\xa2\x10", "42") == "hello there" );
+        REQUIRE_FALSE( enc->decode("\x84\xbf\xd1\xc9\xa8\x59\xf7\xaf\x31\xa2\x10", "bad") == "hello there" );
+    }
+
+    SECTION("Test Nonces") {
+        const std::shared_ptr<const KeySchedule> schedule = enc->prepare("42", std::string(16, 'a'));
+        const std::shared_ptr<const KeySchedule> otherSchedule = enc->prepare("42", std::string(16, 'b'));
+        REQUIRE( enc->encode("hello there", *schedule) != enc->encode("hello there", *otherSchedule) );
+        REQUIRE( enc->decode(enc->encode("hello there", *schedule), *schedule) == "hello there" );
+    }
+}
+
+TEST_CASE("Test Multithreaded Encodings") {
+    // An odd length, so the threads split the text partway through keystream blocks and hashchar's 32-character hashes
+    std::string text;
+    for (int i = 0; i < 1000003; i++) text += static_cast<char>(i * 37 % 256);
+
+    for (const std::string name : {"shiftchar", "hashchar", "aesctr"}) {
+        const Encoding* enc = encodingFromName(name);
+        const std::string encoded = enc->encode(text, "42");
+        const std::string decoded = enc->decode(encoded, "42");
+        const std::string encodedBytes = enc->encodeBytes(text, "42");
+
+        for (const int threads : {0, 2, 3, 7}) {
+            REQUIRE( enc->encode(text, "42", threads) == encoded );
+            REQUIRE( enc->decode(encoded, "42", threads) == decoded );
+            REQUIRE( enc->encodeBytes(text, "42", threads) == encodedBytes );
+            REQUIRE( enc->decodeBytes(encodedBytes, "42", threads) == text );
+        }
+    }
+}
+
+TEST_CASE("Test Bytes") {
+    std::string bytes;
+    for (int i = 0; i < 256; i++) bytes += static_cast<char>(i);
+
+    SECTION("Test Plain") {
+        const Encoding* enc = encodingFromName("plain");
+        REQUIRE( enc->encodeBytes(bytes, "42") == bytes );
+        REQUIRE( enc->decodeBytes(bytes, "42") == bytes );
+    }
+
+    SECTION("Test ShiftAll") {
+        const Encoding* enc = encodingFromName("shiftall");
+        const std::string encoded = enc->encodeBytes(bytes, "42");
+        REQUIRE( encoded.length() == bytes.length() );
+        REQUIRE( encoded != bytes );
+        REQUIRE( enc->decodeBytes(encoded, "42") == bytes );
+        REQUIRE_FALSE( enc->decodeBytes(encoded, "bad") == bytes );
+    }
+
+    SECTION("Test ShiftChar") {
+        const Encoding* enc = encodingFromName("shiftchar");
+        const std::string encoded = enc->encodeBytes(bytes, "42");
+        REQUIRE( encoded.length() == bytes.length() );
+        REQUIRE( encoded != bytes );
+        REQUIRE( enc->decodeBytes(encoded, "42") == bytes );
+        REQUIRE_FALSE( enc->decodeBytes(encoded, "bad") == bytes );
+    }
+}
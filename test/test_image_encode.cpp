@@ -104,4 +104,197 @@ TEST_CASE("Test Image Decoding") {
         const std::string decoded = decodeText(outputImage, 4);
         REQUIRE(decoded == text);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test Non-Continuous Image") {
+    cv::Mat image(4, 10, CV_8UC4, cv::Scalar::all(255));
+    cv::Mat roi = image(cv::Rect(1, 1, 5, 2));
+    REQUIRE_FALSE(roi.isContinuous());
+
+    for (const int bitWidth : {1, 2, 4}) {
+        const std::string text = "Hi!";
+        encodeText(roi, text, bitWidth);
+        REQUIRE(decodeText(roi, bitWidth) == text);
+    }
+
+    // Pixels outside of the region of interest are left untouched
+    for (int j = 0; j < image.cols; j++) {
+        REQUIRE(image.at<cv::Vec4b>(0, j) == cv::Vec4b(255, 255, 255, 255));
+        REQUIRE(image.at<cv::Vec4b>(3, j) == cv::Vec4b(255, 255, 255, 255));
+    }
+    REQUIRE(image.at<cv::Vec4b>(1, 0) == cv::Vec4b(255, 255, 255, 255));
+    REQUIRE(image.at<cv::Vec4b>(2, 6) == cv::Vec4b(255, 255, 255, 255));
+}
+
+
+TEST_CASE("Test Multithreaded Image Encoding") {
+    cv::Mat image(7, 9, CV_8UC4);
+    cv::randu(image, 0, 256);
+    const std::string text = "The quick brown fox jumps over the lazy dog";
+
+    for (const int bitWidth : {1, 2, 4}) {
+        cv::Mat serial = image.clone();
+        cv::Mat parallel = image.clone();
+        encodeText(serial, text.substr(0, bitWidth * 6), bitWidth, 1, 42);
+        encodeText(parallel, text.substr(0, bitWidth * 6), bitWidth, 4, 42);
+
+        // With the same noise seed the whole image is identical, including the noise after the text
+        REQUIRE( std::equal(serial.datastart, serial.dataend, parallel.datastart) );
+        REQUIRE( decodeText(parallel, bitWidth, 1) == text.substr(0, bitWidth * 6) );
+        REQUIRE( decodeText(serial, bitWidth, 3) == text.substr(0, bitWidth * 6) );
+        // Unterminated images decode the same regardless of the number of threads
+        REQUIRE( decodeText(image, bitWidth, 1) == decodeText(image, bitWidth, 4) );
+    }
+}
+
+
+TEST_CASE("Test Decoding Fixed Ranges") {
+    cv::Mat image(10, 11, CV_8UC4);
+    cv::randu(image, 0, 256);
+    const std::string text = std::string("Nulls\0are kept", 14) + " when the length is known";
+
+    for (const int bitWidth : {1, 2, 4}) {
+        cv::Mat encoded = image.clone();
+        encodeText(encoded, text, bitWidth, 1, 7);
+        const size_t capacity = textCapacity(encoded, bitWidth);
+        REQUIRE( capacity == 10 * 11 * bitWidth / 2 );
+
+        for (const int threads : {1, 3}) {
+            REQUIRE( decodeChars(encoded, bitWidth, 0, text.length(), threads) == text );
+            REQUIRE( decodeChars(encoded, bitWidth, 3, 9, threads) == text.substr(3, 9) );
+            REQUIRE( decodeChars(encoded, bitWidth, 5, 1, threads) == text.substr(5, 1) );
+            // Reading past the end of the image stops at the last character
+            REQUIRE( decodeChars(encoded, bitWidth, capacity - 2, 10, threads).length() == 2 );
+            REQUIRE( decodeChars(encoded, bitWidth, capacity, 10, threads).empty() );
+        }
+    }
+}
+
+
+TEST_CASE("Test Packed Bit Widths") {
+    cv::Mat image(5, 7, CV_8UC4);
+    cv::randu(image, 0, 256);
+    const std::string text = "Packed \xff\x80 bits";
+
+    SECTION("Bit Width 3") {
+        cv::Mat outputImage = image.clone();
+        encodeText(outputImage, "abc", 3);
+
+        // 'a', 'b', 'c' form the 24 bits 0x636261, which are split into 3-bit values from the lowest bit up
+        const std::vector<int> expected = { 1, 4, 1, 1, 6, 6, 0, 3 };
+        for (int i = 0; i < expected.size(); i++)
+            REQUIRE( outputImage.at<cv::Vec4b>(0, i / 4)[i % 4] == ((image.at<cv::Vec4b>(0, i / 4)[i % 4] & 0xF8) | expected[i]) );
+    }
+
+    SECTION("Bit Width 8") {
+        cv::Mat outputImage = image.clone();
+        encodeText(outputImage, "Hey", 8);
+        REQUIRE( outputImage.at<cv::Vec4b>(0, 0) == cv::Vec4b('H', 'e', 'y', 0) );
+        // Four null characters terminate the text so that one of them ends a pixel
+        for (int i = 0; i < 3; i++) REQUIRE( outputImage.at<cv::Vec4b>(0, 1)[i] == 0 );
+    }
+
+    SECTION("Round Trip") {
+        for (const int bitWidth : supportedBitWidths()) {
+            cv::Mat outputImage = image.clone();
+            encodeText(outputImage, text, bitWidth, 3);
+            REQUIRE( decodeText(outputImage, bitWidth) == text );
+            REQUIRE( decodeText(outputImage, bitWidth, 2) == text );
+
+            // Each channel only changes within its low bits
+            for (size_t i = 0; i < image.total() * 4; i++)
+                REQUIRE( (outputImage.data[i] >> bitWidth) == (image.data[i] >> bitWidth) );
+        }
+    }
+
+    REQUIRE_FALSE( isSupportedBitWidth(5) );
+    REQUIRE( textCapacity(image, 3) == 35 * 4 / 8 * 3 );
+    REQUIRE( textCapacity(image, 6) == 35 * 3 );
+}
+
+
+TEST_CASE("Test Native Channel Layouts") {
+    const std::string text = "Grayscale and color covers";
+
+    for (const int channels : {1, 2, 3}) {
+        cv::Mat image(12, 20, CV_MAKETYPE(CV_8U, channels));
+        cv::randu(image, 0, 256);
+
+        for (const int bitWidth : supportedBitWidths()) {
+            cv::Mat outputImage = image.clone();
+            encodeText(outputImage, text, bitWidth, 2);
+            REQUIRE( outputImage.channels() == channels );
+            REQUIRE( decodeText(outputImage, bitWidth) == text );
+            REQUIRE( decodeText(outputImage, bitWidth, 3) == text );
+            REQUIRE( decodeChars(outputImage, bitWidth, 6, 5) == text.substr(6, 5) );
+            REQUIRE( textCapacity(outputImage, bitWidth) == textCapacity(cv::Mat(1, 12 * 20 * channels, CV_8UC1), bitWidth) );
+        }
+    }
+
+    SECTION("Same Channel Stream") {
+        // The text is laid out across the channels the same way regardless of how they are grouped into pixels
+        cv::Mat color = cv::Mat::zeros(4, 4, CV_8UC3);
+        cv::Mat gray = cv::Mat::zeros(4, 12, CV_8UC1);
+        encodeText(color, "abc", 2);
+        encodeText(gray, "abc", 2);
+        REQUIRE( std::equal(color.datastart, color.datastart + 12, gray.datastart) );
+    }
+}
+
+
+TEST_CASE("Test 16-Bit Images") {
+    const std::string text = "Sixteen bits per channel";
+
+    for (const int channels : {3, 4}) {
+        cv::Mat image(8, 10, CV_MAKETYPE(CV_16U, channels));
+        cv::randu(image, 0, 65536);
+
+        for (const int bitWidth : supportedBitWidths()) {
+            cv::Mat outputImage = image.clone();
+            encodeText(outputImage, text, bitWidth, 2);
+            REQUIRE( outputImage.depth() == CV_16U );
+            REQUIRE( decodeText(outputImage, bitWidth) == text );
+            REQUIRE( decodeText(outputImage, bitWidth, 3) == text );
+            REQUIRE( decodeChars(outputImage, bitWidth, 4, 7) == text.substr(4, 7) );
+
+            // Each channel only changes within its low bits
+            const ushort* original = image.ptr<ushort>();
+            const ushort* encoded = outputImage.ptr<ushort>();
+            for (size_t i = 0; i < image.total() * channels; i++)
+                REQUIRE( (encoded[i] >> bitWidth) == (original[i] >> bitWidth) );
+        }
+    }
+
+    SECTION("Same Layout as 8-Bit") {
+        cv::Mat wide = cv::Mat::zeros(2, 8, CV_16UC4);
+        cv::Mat narrow = cv::Mat::zeros(2, 8, CV_8UC4);
+        encodeText(wide, "16", 4);
+        encodeText(narrow, "16", 4);
+        for (int i = 0; i < 4; i++) REQUIRE( wide.ptr<ushort>()[i] == narrow.ptr<uchar>()[i] );
+    }
+}
+
+
+TEST_CASE("Test Bounded Noise") {
+    cv::Mat image(20, 20, CV_8UC4);
+    cv::randu(image, 0, 256);
+    const std::string text = "Short message";
+
+    for (const int bitWidth : supportedBitWidths()) {
+        for (const size_t noiseLength : {0, 10}) {
+            cv::Mat outputImage = image.clone();
+            encodeText(outputImage, text, bitWidth, 3, 42, noiseLength);
+            REQUIRE( decodeText(outputImage, bitWidth) == text );
+
+            // Only the pixels holding the text, its terminator, and the noise are touched
+            const size_t channels = (text.length() + 4 + noiseLength) * 8 / bitWidth + 8;
+            REQUIRE( std::equal(outputImage.datastart + channels, outputImage.dataend, image.datastart + channels) );
+
+            // The touched pixels match an encoding that fills the whole image with noise
+            cv::Mat filled = image.clone();
+            encodeText(filled, text, bitWidth, 1, 42);
+            const size_t textChannels = (text.length() + noiseLength) * 8 / bitWidth;
+            REQUIRE( std::equal(outputImage.data, outputImage.data + textChannels, filled.data) );
+        }
+    }
+}
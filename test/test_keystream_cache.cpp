@@ -0,0 +1,175 @@
+//
+// Created by matthew on 3/9/25.
+//
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <catch2/catch_test_macros.hpp>
+
+#include "encodings.h"
+#include "keystream_cache.h"
+
+
+/**
+ * Makes an empty directory for a test to cache keystreams in
+ * @param name The name of the test
+ * @return The path to the directory
+ */
+static std::string emptyCacheDirectory(const std::string& name) {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / ("icrypt-test-" + name);
+    std::filesystem::remove_all(directory);
+    return directory.string();
+}
+
+
+TEST_CASE("Test Keystream Cache") {
+    const std::string directory = emptyCacheDirectory("keystream-cache");
+
+    size_t generated = 0;
+    const KeystreamCache::Generator generate = [&](uint8_t* shifts, const size_t index, const size_t count) {
+        for (size_t i = 0; i < count; i++) shifts[i] = static_cast<uint8_t>((index + i) * 7 % 128);
+        generated += count;
+    };
+
+    SECTION("Test Build and Reuse") {
+        {
+            KeystreamCache cache(directory, "key", generate);
+            REQUIRE( cache.length() == 0 );
+
+            const uint8_t* shifts = cache.shifts(1000);
+            REQUIRE( shifts != nullptr );
+            REQUIRE( cache.length() == 1000 );
+            for (size_t i = 0; i < 1000; i++) REQUIRE( shifts[i] == i * 7 % 128 );
+        }
+
+        // Opening the cache again only regenerates the shifts that are spot checked
+        generated = 0;
+        KeystreamCache cache(directory, "key", generate);
+        REQUIRE( cache.length() == 1000 );
+        REQUIRE( cache.shifts(500) != nullptr );
+        REQUIRE( generated <= 128 );
+
+        // A longer keystream only generates the new shifts
+        generated = 0;
+        const uint8_t* shifts = cache.shifts(3000);
+        REQUIRE( cache.length() == 3000 );
+        REQUIRE( generated == 2000 + 128 );
+        for (size_t i = 0; i < 3000; i++) REQUIRE( shifts[i] == i * 7 % 128 );
+    }
+
+    SECTION("Test Separate Keys") {
+        KeystreamCache cache(directory, "key", generate);
+        REQUIRE( cache.shifts(100) != nullptr );
+
+        KeystreamCache otherCache(directory, "other key", generate);
+        REQUIRE( otherCache.length() == 0 );
+    }
+
+    SECTION("Test File Name") {
+        KeystreamCache cache(directory, "key", generate);
+        REQUIRE( cache.shifts(100) != nullptr );
+
+        // Files are only named by the domain-separated digest of the key
+        std::string name;
+        char hex[3];
+        for (const uint8_t byte : sha256("icrypt-keystreamkey")) {
+            snprintf(hex, sizeof(hex), "%02x", byte);
+            name += hex;
+        }
+        REQUIRE( std::filesystem::directory_iterator(directory)->path().filename() == name + ".keystream" );
+    }
+
+    SECTION("Test Corrupt Cache") {
+        std::filesystem::path path;
+        {
+            KeystreamCache cache(directory, "key", generate);
+            REQUIRE( cache.shifts(1000) != nullptr );
+            path = std::filesystem::directory_iterator(directory)->path();
+        }
+
+        // Flip a shift in the middle, which the spot checks would miss
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(static_cast<std::streamoff>(std::filesystem::file_size(path)) - 500);
+            file.put(static_cast<char>(0xFF));
+        }
+
+        // The block is checked when it is read, and only it is generated again
+        KeystreamCache cache(directory, "key", generate);
+        REQUIRE( cache.length() == 1000 );
+        generated = 0;
+        const uint8_t* shifts = cache.shifts(1000);
+        REQUIRE( generated == 1000 + 128 );
+        for (size_t i = 0; i < 1000; i++) REQUIRE( shifts[i] == i * 7 % 128 );
+    }
+
+    SECTION("Test Only Read Blocks Are Checked") {
+        // Three blocks of a megabyte each, the last of them partial
+        const size_t length = (3 << 20) - 1000;
+        std::filesystem::path path;
+        {
+            KeystreamCache cache(directory, "key", generate);
+            REQUIRE( cache.shifts(length) != nullptr );
+            path = std::filesystem::directory_iterator(directory)->path();
+        }
+
+        // Corrupt the middle of the last block, which reading the first blocks never looks at
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(static_cast<std::streamoff>(std::filesystem::file_size(path)) - 500000);
+            file.put(static_cast<char>(0xFF));
+        }
+
+        KeystreamCache cache(directory, "key", generate);
+        generated = 0;
+        REQUIRE( cache.shifts(1000) != nullptr );
+        REQUIRE( cache.shifts(2 << 20) != nullptr );
+        REQUIRE( generated <= 128 );
+
+        // Reading the last block finds it corrupt, and only it is generated again
+        const uint8_t* shifts = cache.shifts(length);
+        REQUIRE( generated == 128 + (length - (2 << 20)) );
+        for (size_t i = 0; i < length; i += 997) REQUIRE( shifts[i] == i * 7 % 128 );
+        REQUIRE( shifts[length - 500000] == (length - 500000) * 7 % 128 );
+    }
+
+    SECTION("Test Stale Cache") {
+        {
+            KeystreamCache cache(directory, "key", generate);
+            REQUIRE( cache.shifts(1000) != nullptr );
+        }
+
+        // A cache written by a generator with different shifts is intact but must not be used
+        const KeystreamCache::Generator otherGenerate = [](uint8_t* shifts, const size_t index, const size_t count) {
+            for (size_t i = 0; i < count; i++) shifts[i] = static_cast<uint8_t>((index + i) * 3 % 128);
+        };
+        KeystreamCache cache(directory, "key", otherGenerate);
+        REQUIRE( cache.length() == 0 );
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+
+TEST_CASE("Test Cached ShiftChar") {
+    const Encoding* enc = encodingFromName("shiftchar");
+
+    std::string text;
+    for (int i = 0; i < 200003; i++) text += static_cast<char>(i * 37 % 256);
+    const std::string encoded = enc->encode(text, "42");
+    const std::string decoded = enc->decode(text, "42");
+    const std::string encodedBytes = enc->encodeBytes(text, "42");
+
+    setKeystreamCacheDirectory(emptyCacheDirectory("cached-shiftchar"));
+    for (const int threads : {1, 3}) {
+        REQUIRE( enc->encode(text, "42", threads) == encoded );
+        REQUIRE( enc->decode(text, "42", threads) == decoded );
+        REQUIRE( enc->encodeBytes(text, "42", threads) == encodedBytes );
+        REQUIRE( enc->decodeBytes(encodedBytes, "42", threads) == text );
+        REQUIRE( enc->encode(text.substr(0, 1000), "42", threads) == encoded.substr(0, 1000) );
+    }
+
+    std::filesystem::remove_all(keystreamCacheDirectory());
+    setKeystreamCacheDirectory("");
+}
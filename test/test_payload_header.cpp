@@ -0,0 +1,37 @@
+//
+// Created by matthew on 2/12/25.
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "payload_header.h"
+
+
+TEST_CASE("Test Payload Header") {
+
+    SECTION("Test Round Trip") {
+        PayloadHeader header;
+        header.bitWidth = 2;
+        header.encodingId = 1;
+        header.flags = 0;
+        header.length = 0x0102030405060708;
+
+        const std::string packed = packHeader(header);
+        REQUIRE( packed.length() == payloadHeaderSize );
+
+        PayloadHeader unpacked;
+        REQUIRE( unpackHeader(packed, unpacked) );
+        REQUIRE( unpacked.version == payloadHeaderVersion );
+        REQUIRE( unpacked.bitWidth == 2 );
+        REQUIRE( unpacked.encodingId == 1 );
+        REQUIRE( unpacked.flags == 0 );
+        REQUIRE( unpacked.length == 0x0102030405060708 );
+    }
+
+    SECTION("Test Images Without a Header") {
+        PayloadHeader header;
+        REQUIRE_FALSE( unpackHeader("aGVsbG8gdGhlcmUh", header) );
+        REQUIRE_FALSE( unpackHeader(std::string(payloadHeaderSize, '\0'), header) );
+        REQUIRE_FALSE( unpackHeader(packHeader(header).substr(0, payloadHeaderSize - 1), header) );
+    }
+}
@@ -0,0 +1,70 @@
+//
+// Created by matthew on 3/23/25.
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "base64.h"
+#include "pipeline.h"
+
+
+/**
+ * Builds a payload in full the way the pipeline produces it a block at a time
+ * @param prefix The characters before the payload
+ * @param input The input to produce the payload from
+ * @param raw Whether the payload is the exact bytes of the input instead of its base64 encoding
+ * @param enc The encoding to encode the payload with
+ * @param schedule The key schedule to encode with
+ * @return The prefix followed by the encoded payload
+ */
+static std::string storedPayload(const std::string& prefix, const std::string& input, const bool raw,
+                                 const Encoding* enc, const KeySchedule& schedule) {
+    if (raw) return prefix + enc->encodeBytes(input, schedule);
+    return prefix + enc->encode(base64Encode(input), schedule);
+}
+
+
+TEST_CASE("Test Pipeline") {
+    std::string input;
+    for (int i = 0; i < 20011; i++) input += static_cast<char>(i * 131 % 256);
+    const std::string prefix = "a header of some length";
+
+    for (const std::string name : {"plain", "shiftall", "shiftchar", "aesctr", "hashchar"}) {
+        const Encoding* enc = encodingFromName(name);
+        const std::shared_ptr<const KeySchedule> schedule = enc->prepare("42", "a nonce");
+
+        for (const bool raw : {false, true}) {
+            const std::string expected = storedPayload(prefix, input, raw, enc, *schedule);
+            const std::unique_ptr<MessageSource> message = makePipeline(prefix, input, raw, enc, *schedule);
+
+            SECTION("Test Characters " + name + " " + std::to_string(raw)) {
+                REQUIRE( message->length() == expected.length() );
+
+                // Runs may start and end anywhere, including partway through the prefix and base64 groups
+                std::string buffer(expected.length(), '\0');
+                for (size_t index = 0; index < expected.length(); index += 997) {
+                    for (const size_t count : {size_t{1}, size_t{2}, size_t{5}, size_t{30}, size_t{4096}}) {
+                        const size_t clamped = std::min(count, expected.length() - index);
+                        const char* chars = message->chars(index, clamped, buffer.data());
+                        REQUIRE( std::string(chars, clamped) == expected.substr(index, clamped) );
+                    }
+                }
+            }
+
+            SECTION("Test Embedding " + name + " " + std::to_string(raw)) {
+                cv::Mat image(271, 277, CV_8UC3);
+                cv::randu(image, 0, 256);
+
+                for (const int bitWidth : {1, 3, 8}) {
+                    for (const int threads : {1, 2, 7}) {
+                        cv::Mat stored = image.clone();
+                        cv::Mat piped = image.clone();
+                        encodeText(stored, expected, bitWidth, threads, 42);
+                        encodeMessage(piped, *message, bitWidth, threads, 42);
+                        REQUIRE( std::equal(stored.datastart, stored.dataend, piped.datastart) );
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+//
+// Created by matthew on 3/16/25.
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "sha256.h"
+
+
+/**
+ * Formats a digest as lowercase hexadecimal
+ * @param digest The digest to format
+ * @return The hexadecimal digest
+ */
+static std::string hexOf(const std::array<uint8_t, sha256Size>& digest) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (const uint8_t byte : digest) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0xF];
+    }
+    return hex;
+}
+
+
+TEST_CASE("Test SHA-256") {
+
+    SECTION("Test Known Digests") {
+        REQUIRE( hexOf(sha256("")) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" );
+        REQUIRE( hexOf(sha256("abc")) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" );
+        REQUIRE( hexOf(sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")) ==
+                 "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" );
+        REQUIRE( hexOf(sha256(std::string(1000000, 'a'))) ==
+                 "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" );
+    }
+
+    SECTION("Test Padding Boundaries") {
+        // Lengths around the point where the padding spills into a second block
+        REQUIRE( hexOf(sha256(std::string(55, 'a'))) == "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318" );
+        REQUIRE( hexOf(sha256(std::string(56, 'a'))) == "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a" );
+        REQUIRE( hexOf(sha256(std::string(64, 'a'))) == "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb" );
+    }
+}
@@ -0,0 +1,35 @@
+//
+// Created by matthew on 2/9/25.
+//
+
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include "tail_noise.h"
+
+
+TEST_CASE("Test Tail Noise") {
+    const TailNoise noise(42);
+
+    SECTION("Test Base64 Characters") {
+        std::string chars(1000, '\0');
+        noise.fill(chars.data(), 0, chars.size());
+        REQUIRE( chars.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/") == std::string::npos );
+    }
+
+    SECTION("Test Ranges Match Single Characters") {
+        std::string chars(37, '\0');
+        noise.fill(chars.data(), 5, chars.size());
+        for (size_t i = 0; i < chars.size(); i++)
+            REQUIRE( chars[i] == noise.at(5 + i) );
+    }
+
+    SECTION("Test Seeds") {
+        std::string first(64, '\0'), second(64, '\0'), other(64, '\0');
+        noise.fill(first.data(), 0, first.size());
+        TailNoise(42).fill(second.data(), 0, second.size());
+        TailNoise(43).fill(other.data(), 0, other.size());
+        REQUIRE( first == second );
+        REQUIRE_FALSE( first == other );
+    }
+}